@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cube.h>
+#include <kociemba.h>
+#include <logger.h>
+
+
+/*
+    Batch solver for offline use.
+    Reads one cube per line from a file or stdin, solves them on a pool of threads and writes
+    one result per input line to stdout in the input order. At most MaxInFlight cubes are read ahead
+    of the output, so memory does not grow with the input.
+    Text results are turns separated by spaces or "error". Binary results are the count of turns
+    as a byte, 255 for errors, followed by one byte of ETurnExt per turn.
+    The log and the throughput reports go to stderr.
+*/
+
+struct TOptions {
+    std::string InputPath = "-";                    // "-" for stdin
+    size_t Threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t MaxInFlight = 0;                         // 0 for 4 cubes per thread
+    bool Binary = false;
+    std::string TablesDir;
+    size_t ReduceWindow = 0;                        // Window of the post-pass over solutions, 0 disables it
+    double ReportInterval = 10;                     // Seconds between throughput reports, 0 disables them
+};
+
+
+static void PrintUsage(const char *name) {
+    std::cerr << "Usage: " << name << " [--input PATH|-] [--threads N] [--max-in-flight N] [--format text|binary]"
+              << " [--tables-dir PATH] [--reduce-window N] [--report-interval SECONDS]" << std::endl;
+}
+
+static bool ParseCommandLine(int argc, char *argv[], TOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || i + 1 >= argc) {
+            PrintUsage(argv[0]);
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--input")
+            options.InputPath = value;
+        else if (arg == "--threads")
+            options.Threads = std::max<size_t>(1, std::stoul(value));
+        else if (arg == "--max-in-flight")
+            options.MaxInFlight = std::stoul(value);
+        else if (arg == "--format" && (value == "text" || value == "binary"))
+            options.Binary = (value == "binary");
+        else if (arg == "--tables-dir")
+            options.TablesDir = value;
+        else if (arg == "--reduce-window")
+            options.ReduceWindow = std::stoul(value);
+        else if (arg == "--report-interval")
+            options.ReportInterval = std::stod(value);
+        else {
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+    if (options.MaxInFlight == 0)
+        options.MaxInFlight = options.Threads * 4;
+    return true;
+}
+
+
+/*
+    Lines of the input. A file is mapped and split in place, stdin is read by lines.
+*/
+class TLineReader {
+    public:
+        explicit TLineReader(const std::string &path) {
+            if (path == "-")
+                return;
+            Fd = open(path.c_str(), O_RDONLY);
+            struct stat st;
+            if (Fd < 0 || fstat(Fd, &st) != 0)
+                throw std::runtime_error("Can't open " + path);
+            Size = st.st_size;
+            if (Size == 0)
+                return;
+            void *data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, Fd, 0);
+            if (data == MAP_FAILED)
+                throw std::runtime_error("Can't map " + path);
+            madvise(data, Size, MADV_SEQUENTIAL);
+            Data = static_cast<const char *>(data);
+        }
+
+        ~TLineReader() {
+            if (Data)
+                munmap(const_cast<char *>(Data), Size);
+            if (Fd >= 0)
+                close(Fd);
+        }
+
+        bool Next(std::string &line) {
+            if (Fd < 0) {
+                if (!std::getline(std::cin, line))
+                    return false;
+            } else {
+                if (Offset >= Size)
+                    return false;
+                const char *begin = Data + Offset;
+                const char *end = static_cast<const char *>(std::memchr(begin, '\n', Size - Offset));
+                if (!end)
+                    end = Data + Size;
+                line.assign(begin, end);
+                Offset = end - Data + 1;
+            }
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            return true;
+        }
+
+    private:
+        int Fd = -1;
+        const char *Data = nullptr;
+        size_t Size = 0;
+        size_t Offset = 0;
+};
+
+
+/*
+    Cubes are numbered in the input order and kept in a ring of MaxInFlight slots.
+    The main thread reads cubes while the ring has room, solvers take them in order,
+    the writer thread prints the solved ones as soon as all the cubes before them are printed.
+*/
+class TBatchSolver {
+    public:
+        explicit TBatchSolver(const TOptions &options)
+            : Options(options)
+            , Slots(options.MaxInFlight)
+        {
+            Reduce.WindowSize = options.ReduceWindow;
+            Reduce.ThreadsCount = 1;                    // Cubes are already solved on all the threads
+        }
+
+        void Run(TLineReader &reader) {
+            Start = std::chrono::steady_clock::now();
+            LastReport = Start;
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < Options.Threads; ++i)
+                threads.emplace_back([this]() { Solve(); });
+            std::thread writer([this]() { Write(); });
+            std::string line;
+            while (reader.Next(line)) {
+                std::unique_lock<std::mutex> lk(Mutex);
+                Changed.wait(lk, [this]() { return Read - Written < Slots.size(); });
+                TSlot &slot = Slots[Read % Slots.size()];
+                slot.Cube.swap(line);
+                slot.Done = false;
+                ++Read;
+                Changed.notify_all();
+            }
+            {
+                std::unique_lock<std::mutex> lk(Mutex);
+                Eof = true;
+                Changed.notify_all();
+            }
+            for (auto &thread : threads)
+                thread.join();
+            writer.join();
+            Report(true);
+        }
+
+    private:
+        struct TSlot {
+            std::string Cube;
+            std::vector<ETurnExt> Solution;
+            bool Solved = false;
+            bool Done = false;
+        };
+
+        const TOptions &Options;
+        TReduceOptions Reduce;
+        std::mutex Mutex;
+        std::condition_variable Changed;                // Signals read, solved and written cubes
+        std::vector<TSlot> Slots;
+        size_t Read = 0;                                // Cubes read so far
+        size_t Started = 0;                             // Cubes taken by solvers so far
+        size_t Written = 0;                             // Results written so far
+        bool Eof = false;
+        // Used by the writer only
+        size_t SolvedCount = 0;
+        size_t TotalLength = 0;
+        std::chrono::steady_clock::time_point Start;
+        std::chrono::steady_clock::time_point LastReport;
+
+        void Solve() {
+            std::unique_lock<std::mutex> lk(Mutex);
+            for (; ;) {
+                Changed.wait(lk, [this]() { return Started < Read || Eof; });
+                if (Started >= Read)
+                    return;
+                size_t index = Started++;
+                std::string cube = Slots[index % Slots.size()].Cube;
+                lk.unlock();
+                std::vector<ETurnExt> solution;
+                bool solved = false;
+                try {
+                    solved = KociembaSolution(MakePuzzle(cube), solution, nullptr, Options.ReduceWindow != 0 ? &Reduce : nullptr);
+                } catch (...) {
+                    solved = false;
+                }
+                lk.lock();
+                TSlot &slot = Slots[index % Slots.size()];
+                slot.Solution.swap(solution);
+                slot.Solved = solved;
+                slot.Done = true;
+                Changed.notify_all();
+            }
+        }
+
+        void Write() {
+            std::vector<ETurnExt> solution;
+            std::unique_lock<std::mutex> lk(Mutex);
+            for (; ;) {
+                auto ready = [this]() { return Written < Read && Slots[Written % Slots.size()].Done; };
+                if (!ready()) {
+                    // Nothing to print now, what is printed becomes visible while waiting
+                    lk.unlock();
+                    fflush(stdout);
+                    lk.lock();
+                }
+                Changed.wait(lk, [this, &ready]() { return ready() || (Eof && Written == Read); });
+                if (!ready())
+                    break;
+                TSlot &slot = Slots[Written % Slots.size()];
+                solution.swap(slot.Solution);
+                bool solved = slot.Solved;
+                ++Written;
+                Changed.notify_all();
+                lk.unlock();
+                WriteResult(solved, solution);
+                Report(false);
+                lk.lock();
+            }
+            lk.unlock();
+            fflush(stdout);
+        }
+
+        void WriteResult(bool solved, const std::vector<ETurnExt> &solution) {
+            if (solved) {
+                ++SolvedCount;
+                TotalLength += solution.size();
+            }
+            if (Options.Binary) {
+                unsigned char buffer[256];
+                size_t size = 0;
+                buffer[size++] = solved ? static_cast<unsigned char>(solution.size()) : 255;
+                for (size_t i = 0; solved && i < solution.size(); ++i)
+                    buffer[size++] = static_cast<unsigned char>(solution[i]);
+                fwrite(buffer, 1, size, stdout);
+                return;
+            }
+            std::string line;
+            for (ETurnExt turn : solution) {
+                if (!line.empty())
+                    line += ' ';
+                line += TurnExt2String(turn);
+            }
+            if (!solved)
+                line = "error";
+            line += '\n';
+            fwrite(line.data(), 1, line.size(), stdout);
+        }
+
+        void Report(bool final) {
+            auto now = std::chrono::steady_clock::now();
+            if (!final && (Options.ReportInterval <= 0 ||
+                           std::chrono::duration<double>(now - LastReport).count() < Options.ReportInterval))
+                return;
+            LastReport = now;
+            double seconds = std::chrono::duration<double>(now - Start).count();
+            std::cerr << std::fixed << std::setprecision(3)
+                      << (final ? "Done: " : "Progress: ") << Written << " cubes, " << SolvedCount << " solved in "
+                      << seconds << "s, " << (seconds > 0 ? Written / seconds : 0.0) << " cubes/s, average length "
+                      << (SolvedCount ? static_cast<double>(TotalLength) / SolvedCount : 0.0) << std::endl;
+        }
+};
+
+
+int main(int argc, char *argv[]) {
+    TOptions options;
+    if (!ParseCommandLine(argc, argv, options))
+        return 1;
+    TLogger::Instance().SetConsole(stderr);
+    try {
+        TLineReader reader(options.InputPath);
+        InitKociemba(options.TablesDir);
+        TLogger::Instance().Flush();
+        TBatchSolver solver(options);
+        solver.Run(reader);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <cube.h>
 #include <kociemba.h>
+#include <logger.h>
 
 
 bool RunTest(const TCube &puzzle) {
@@ -53,6 +54,7 @@ void RunTests() {
 
 int main() {
     InitKociemba();
+    TLogger::Instance().Flush();
     RunTests();
     return 0;
 }
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+#include <cube.h>
+#include <kociemba.h>
+#include <logger.h>
+
+
+/*
+    End-to-end benchmark of KociembaSolution.
+    Builds seeded scramble corpora, solves them with 1 and N threads, verifies every answer
+    and prints throughput, latency percentiles and solution lengths, optionally as json.
+*/
+
+struct TOptions {
+    unsigned Seed = 1;
+    size_t Count = 10;                              // Cubes in every corpus
+    std::vector<size_t> Depths = { 8, 12, 16 };     // Random-move scramble depths
+    size_t RandomStateDepth = 100;                  // Random state is approximated by a walk this long, 0 disables it
+    size_t Threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t ReduceWindow = 0;                        // Window of the post-pass over solutions, 0 disables it
+    std::string JsonPath;
+};
+
+struct TCorpus {
+    std::string Name;
+    std::vector<TCube> Cubes;
+};
+
+struct TRunResult {
+    std::string Corpus;
+    size_t Threads = 0;
+    size_t Count = 0;
+    size_t Solved = 0;
+    size_t Verified = 0;
+    double Seconds = 0;
+    std::vector<double> Latencies;
+    double AverageLength = 0;
+    double AverageNodesExpanded = 0;
+    double AverageHashLookups = 0;
+    double AverageTurnsSaved = 0;
+};
+
+
+static void PrintUsage(const char *name) {
+    std::cerr << "Usage: " << name << " [--seed N] [--count N] [--depths 8,12,16] [--random-state-depth N]"
+              << " [--threads N] [--reduce-window N] [--json PATH]" << std::endl;
+}
+
+static std::vector<size_t> ParseList(const std::string &str) {
+    std::vector<size_t> result;
+    std::istringstream in(str);
+    std::string item;
+    while (std::getline(in, item, ','))
+        if (!item.empty())
+            result.push_back(std::stoul(item));
+    return result;
+}
+
+static bool ParseCommandLine(int argc, char *argv[], TOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || i + 1 >= argc) {
+            PrintUsage(argv[0]);
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--seed")
+            options.Seed = std::stoul(value);
+        else if (arg == "--count")
+            options.Count = std::stoul(value);
+        else if (arg == "--depths")
+            options.Depths = ParseList(value);
+        else if (arg == "--random-state-depth")
+            options.RandomStateDepth = std::stoul(value);
+        else if (arg == "--threads")
+            options.Threads = std::max<size_t>(1, std::stoul(value));
+        else if (arg == "--reduce-window")
+            options.ReduceWindow = std::stoul(value);
+        else if (arg == "--json")
+            options.JsonPath = value;
+        else {
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Random walk without two turns of the same face in a row
+static TCube Scramble(std::mt19937 &rng, size_t depth) {
+    static constexpr size_t TURNS_COUNT = TE_B1 + 1;
+    std::uniform_int_distribution<size_t> uniform(0, TURNS_COUNT - 1);
+    TMove move;
+    char lastFace = 0;
+    for (size_t i = 0; i < depth; ) {
+        ETurnExt turn = static_cast<ETurnExt>(uniform(rng));
+        char face = TurnExt2String(turn)[0];
+        if (face == lastFace)
+            continue;
+        move *= TurnExt2Move(turn);
+        lastFace = face;
+        ++i;
+    }
+    return move.Act(MakeSolvedCube());
+}
+
+static std::vector<TCorpus> MakeCorpora(const TOptions &options) {
+    std::vector<TCorpus> result;
+    std::mt19937 rng(options.Seed);
+    for (size_t depth : options.Depths) {
+        TCorpus corpus;
+        corpus.Name = "depth-" + std::to_string(depth);
+        for (size_t i = 0; i < options.Count; ++i)
+            corpus.Cubes.push_back(Scramble(rng, depth));
+        result.push_back(std::move(corpus));
+    }
+    if (options.RandomStateDepth != 0) {
+        TCorpus corpus;
+        corpus.Name = "random-state";
+        for (size_t i = 0; i < options.Count; ++i)
+            corpus.Cubes.push_back(Scramble(rng, options.RandomStateDepth));
+        result.push_back(std::move(corpus));
+    }
+    return result;
+}
+
+static TRunResult Run(const TCorpus &corpus, size_t threadsCount, const TReduceOptions *reduce) {
+    using TClock = std::chrono::steady_clock;
+    TRunResult result;
+    result.Corpus = corpus.Name;
+    result.Threads = threadsCount;
+    result.Count = corpus.Cubes.size();
+    result.Latencies.resize(corpus.Cubes.size());
+    std::vector<std::vector<ETurnExt>> solutions(corpus.Cubes.size());
+    std::vector<TSolveStats> stats(corpus.Cubes.size());
+    std::vector<char> solved(corpus.Cubes.size(), 0);
+    std::atomic<size_t> next(0);
+    auto start = TClock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadsCount; ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < corpus.Cubes.size(); i = next++) {
+                auto begin = TClock::now();
+                solved[i] = KociembaSolution(corpus.Cubes[i], solutions[i], &stats[i], reduce) ? 1 : 0;
+                result.Latencies[i] = std::chrono::duration<double>(TClock::now() - begin).count();
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    result.Seconds = std::chrono::duration<double>(TClock::now() - start).count();
+    size_t totalLength = 0;
+    for (size_t i = 0; i < corpus.Cubes.size(); ++i) {
+        for (const TStageStats &stage : stats[i].Stages) {
+            result.AverageNodesExpanded += stage.NodesExpanded;
+            result.AverageHashLookups += stage.HashLookups;
+        }
+        result.AverageTurnsSaved += stats[i].TurnsSaved;
+        if (!solved[i])
+            continue;
+        ++result.Solved;
+        totalLength += solutions[i].size();
+        TMove move;
+        for (ETurnExt turn : solutions[i])
+            move *= TurnExt2Move(turn);
+        if (move.Act(corpus.Cubes[i]) == MakeSolvedCube())
+            ++result.Verified;
+    }
+    result.AverageLength = result.Solved ? static_cast<double>(totalLength) / result.Solved : 0.0;
+    if (result.Count) {
+        result.AverageNodesExpanded /= result.Count;
+        result.AverageHashLookups /= result.Count;
+        result.AverageTurnsSaved /= result.Count;
+    }
+    std::sort(result.Latencies.begin(), result.Latencies.end());
+    return result;
+}
+
+static double Percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static size_t GetPeakRSSKb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return static_cast<size_t>(usage.ru_maxrss);
+}
+
+static void PrintResult(const TRunResult &res) {
+    std::cout << std::fixed << std::setprecision(3)
+              << res.Corpus << ", " << res.Threads << " thread(s): "
+              << res.Solved << "/" << res.Count << " solved, " << res.Verified << " verified, "
+              << (res.Seconds > 0 ? res.Count / res.Seconds : 0.0) << " solutions/s, "
+              << "latency p50=" << Percentile(res.Latencies, 0.5) << "s p90=" << Percentile(res.Latencies, 0.9)
+              << "s p99=" << Percentile(res.Latencies, 0.99) << "s max=" << Percentile(res.Latencies, 1.0) << "s, "
+              << "average length " << res.AverageLength << ", nodes expanded " << res.AverageNodesExpanded
+              << ", hash lookups " << res.AverageHashLookups << ", turns saved " << res.AverageTurnsSaved << std::endl;
+}
+
+static void WriteJson(const std::string &path, const TOptions &options, double initSeconds, const std::vector<TRunResult> &results) {
+    std::ofstream out(path);
+    out << std::setprecision(6);
+    out << "{\n  \"seed\": " << options.Seed << ",\n  \"count\": " << options.Count << ",\n  \"reduce_window\": " << options.ReduceWindow
+        << ",\n  \"init_seconds\": " << initSeconds << ",\n  \"peak_rss_kb\": " << GetPeakRSSKb() << ",\n  \"runs\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const TRunResult &res = results[i];
+        out << (i ? "," : "") << "\n    {\"corpus\": \"" << res.Corpus << "\", \"threads\": " << res.Threads
+            << ", \"count\": " << res.Count << ", \"solved\": " << res.Solved << ", \"verified\": " << res.Verified
+            << ", \"seconds\": " << res.Seconds << ", \"solutions_per_second\": " << (res.Seconds > 0 ? res.Count / res.Seconds : 0.0)
+            << ", \"latency\": {\"p50\": " << Percentile(res.Latencies, 0.5) << ", \"p90\": " << Percentile(res.Latencies, 0.9)
+            << ", \"p99\": " << Percentile(res.Latencies, 0.99) << ", \"max\": " << Percentile(res.Latencies, 1.0) << "}"
+            << ", \"average_length\": " << res.AverageLength << ", \"average_nodes_expanded\": " << res.AverageNodesExpanded
+            << ", \"average_hash_lookups\": " << res.AverageHashLookups
+            << ", \"average_turns_saved\": " << res.AverageTurnsSaved << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+
+int main(int argc, char *argv[]) {
+    TOptions options;
+    if (!ParseCommandLine(argc, argv, options))
+        return 1;
+    auto start = std::chrono::steady_clock::now();
+    InitKociemba();
+    TLogger::Instance().Flush();
+    double initSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Tables are ready in " << initSeconds << "s" << std::endl;
+    TReduceOptions reduce;
+    reduce.WindowSize = options.ReduceWindow;
+    std::vector<TRunResult> results;
+    bool ok = true;
+    for (const auto &corpus : MakeCorpora(options)) {
+        std::vector<size_t> threadCounts = { 1 };
+        if (options.Threads > 1)
+            threadCounts.push_back(options.Threads);
+        for (size_t threads : threadCounts) {
+            results.push_back(Run(corpus, threads, options.ReduceWindow != 0 ? &reduce : nullptr));
+            PrintResult(results.back());
+            ok = ok && results.back().Verified == results.back().Count;
+        }
+    }
+    std::cout << "Peak RSS " << GetPeakRSSKb() << " KB" << std::endl;
+    if (!options.JsonPath.empty())
+        WriteJson(options.JsonPath, options, initSeconds, results);
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
+#include "network/session.h"
+#include "network/session_http.h"
+#include "util/base64.h"
+#include <cube.h>
+
+
+/*
+    Load generator for rubiks_server.
+    Every connection keeps one request in flight, mixing /solve and /log.
+    Cache hits ask for cubes solved during warmup, misses ask for fresh shallow scrambles.
+    Start the server first, e.g. ./rubiks_server --config rubiks.config
+*/
+
+namespace opt = boost::program_options;
+
+using TClock = std::chrono::steady_clock;
+
+struct TLoadOptions {
+    std::string Host;
+    int Port = 17071;
+    size_t Connections = 16;
+    size_t IOThreads = 1;
+    double Duration = 10;                           // Seconds of load, requests in flight are still waited for
+    size_t Requests = 0;                            // Stop after this many requests if not 0
+    bool KeepAlive = true;                          // Reconnect after every reply if false
+    double SolveRatio = 0.8;                        // Share of /solve among all requests, the rest go to /log
+    double CacheHitRatio = 0.9;                     // Share of /solve asking for already solved cubes
+    size_t HotCubes = 32;                           // Cubes solved during warmup
+    size_t ScrambleDepth = 8;
+    unsigned Seed = 1;
+};
+
+
+class TRouteStats {
+    public:
+        void Add(double seconds, int code, const std::string &state) {
+            Latencies.push_back(seconds);
+            ++Codes[code];
+            if (!state.empty())
+                ++States[state];
+        }
+
+        void AddError() {
+            ++Errors;
+        }
+
+        void Merge(const TRouteStats &rgt) {
+            Latencies.insert(Latencies.end(), rgt.Latencies.begin(), rgt.Latencies.end());
+            for (const auto &it : rgt.Codes)
+                Codes[it.first] += it.second;
+            for (const auto &it : rgt.States)
+                States[it.first] += it.second;
+            Errors += rgt.Errors;
+        }
+
+        void Print(const std::string &name, double seconds) {
+            std::sort(Latencies.begin(), Latencies.end());
+            std::cout << std::fixed << std::setprecision(1)
+                      << name << ": " << Latencies.size() << " replies, " << (seconds > 0 ? Latencies.size() / seconds : 0.0) << " rps, "
+                      << Errors << " unanswered" << std::endl;
+            if (Latencies.empty())
+                return;
+            std::cout << "    codes:";
+            for (const auto &it : Codes)
+                std::cout << " " << it.first << "=" << it.second;
+            std::cout << std::endl << "    states:";
+            for (const auto &it : States)
+                std::cout << " " << it.first << "=" << it.second;
+            std::cout << std::endl << std::setprecision(3)
+                      << "    latency ms: p50=" << Percentile(0.5) * 1000 << " p90=" << Percentile(0.9) * 1000
+                      << " p99=" << Percentile(0.99) * 1000 << " max=" << Latencies.back() * 1000 << std::endl;
+            // Buckets grow as 1-2-5 from 100us up
+            double bound = 0.0001;
+            size_t begin = 0;
+            for (size_t step = 0; begin < Latencies.size(); ++step) {
+                size_t end = std::upper_bound(Latencies.begin() + begin, Latencies.end(), bound) - Latencies.begin();
+                if (end != begin)
+                    std::cout << "    <= " << std::setw(10) << bound * 1000 << " ms: " << std::setw(8) << end - begin
+                              << " " << std::string(std::max<size_t>(1, 50 * (end - begin) / Latencies.size()), '#') << std::endl;
+                begin = end;
+                bound *= (step % 3 == 1) ? 2.5 : 2;
+            }
+        }
+
+    private:
+        std::vector<double> Latencies;
+        std::map<int, size_t> Codes;
+        std::map<std::string, size_t> States;
+        size_t Errors = 0;
+
+        double Percentile(double p) const {
+            size_t idx = static_cast<size_t>(p * (Latencies.size() - 1) + 0.5);
+            return Latencies[std::min(idx, Latencies.size() - 1)];
+        }
+};
+
+
+//
+// Cube generation
+//
+
+static std::string Cube2String(const TCube &cube) {
+    static const char colors[] = "wrgyob";      // In order of EColor
+    std::string result;
+    for (size_t i = 0; i < TCube::NUM_FIELDS; ++i)
+        result += colors[cube.GetColor(i)];
+    return result;
+}
+
+// Random walk without two turns of the same face in a row
+static std::string Scramble(std::mt19937 &rng, size_t depth) {
+    std::uniform_int_distribution<int> uniform(TE_U, TE_B1);
+    TMove move;
+    char lastFace = 0;
+    for (size_t i = 0; i < depth; ) {
+        ETurnExt turn = static_cast<ETurnExt>(uniform(rng));
+        char face = TurnExt2String(turn)[0];
+        if (face == lastFace)
+            continue;
+        move *= TurnExt2Move(turn);
+        lastFace = face;
+        ++i;
+    }
+    return Cube2String(move.Act(MakeSolvedCube()));
+}
+
+
+//
+// TLoadGenerator
+//
+
+class TLoadGenerator : private boost::noncopyable {
+    public:
+        explicit TLoadGenerator(const TLoadOptions &options)
+            : Options(options)
+        {
+            std::mt19937 rng(Options.Seed);
+            for (size_t i = 0; i < Options.HotCubes; ++i)
+                HotCubes.push_back(Scramble(rng, Options.ScrambleDepth));
+        }
+
+        bool Warmup();
+        void Run();
+
+    private:
+        class TConnection;
+        using TConnectionPtr = std::shared_ptr<TConnection>;
+
+        enum ERoute {
+            R_SOLVE_HIT,
+            R_SOLVE_MISS,
+            R_LOG,
+            R_COUNT
+        };
+
+        TLoadOptions Options;
+        std::vector<std::string> HotCubes;
+        boost::asio::io_service IOService;
+        std::atomic<size_t> Sent{0};
+        std::atomic<size_t> Active{0};
+        TClock::time_point Deadline;
+        TClock::time_point Finish;
+        std::mutex Mutex;
+        TRouteStats Stats[R_COUNT];
+
+        void RunIOService(std::vector<TConnectionPtr> &connections, double limitSeconds);
+        void OnConnectionFinished(TConnection &connection);
+};
+
+class TLoadGenerator::TConnection : public THTTPReplyHandler, public std::enable_shared_from_this<TConnection> {
+    public:
+        TConnection(TLoadGenerator &host, size_t id, bool warmup)
+            : Host(host)
+            , Id(id)
+            , Rng(host.Options.Seed + 1 + id)
+            , Warmup(warmup)
+        {}
+
+        void Start() {
+            if (Warmup)
+                Pending.assign(Host.HotCubes.begin(), Host.HotCubes.end());
+            SendNext();
+        }
+
+        void Stop() {
+            if (!Session)
+                return;
+            boost::system::error_code ec;
+            Session->GetSocket().close(ec);
+            Session.reset();
+        }
+
+        void ProcessReply(TSessionPtr session, THTTPRequestPtr reply) override {
+            double seconds = std::chrono::duration<double>(TClock::now() - SendingTime).count();
+            std::string protocol, code, status;
+            SplitStartingLine(reply->GetStartingLine(), protocol, code, status);
+            std::string state = GetState(reply->GetBodyStr());
+            Stats[Route].Add(seconds, atoi(code.c_str()), state);
+            if (Warmup && (state == "ok" || state == "fail"))
+                Pending.pop_front();
+            else if (Warmup)
+                Pending.splice(Pending.end(), Pending, Pending.begin());
+            InFlight = false;
+            if (!Host.Options.KeepAlive)
+                Stop();
+            SendNext();
+        }
+
+        const TRouteStats &GetStats(size_t route) const {
+            return Stats[route];
+        }
+
+        bool IsInFlight() const {
+            return InFlight;
+        }
+
+        size_t GetRoute() const {
+            return Route;
+        }
+
+        size_t GetPendingCount() const {
+            return Pending.size();
+        }
+
+    private:
+        TLoadGenerator &Host;
+        size_t Id;
+        std::mt19937 Rng;
+        bool Warmup;
+        std::list<std::string> Pending;             // Warmup polls hot cubes until they are solved
+        TSessionPtr Session;
+        ERoute Route = R_LOG;
+        bool InFlight = false;
+        TClock::time_point SendingTime;
+        TRouteStats Stats[R_COUNT];
+
+        static std::string GetState(const std::string &body) {
+            static const char *states[] = { "\"ok\"", "\"pending\"", "\"fail\"", "\"busy\"", "\"dropped\"" };
+            for (const char *state : states) {
+                if (body.find(state) != std::string::npos)
+                    return std::string(state + 1, strlen(state) - 2);
+            }
+            return std::string();
+        }
+
+        bool HasNext() {
+            if (Warmup)
+                return !Pending.empty() && TClock::now() < Host.Deadline;
+            if (TClock::now() >= Host.Deadline)
+                return false;
+            return Host.Options.Requests == 0 || Host.Sent++ < Host.Options.Requests;
+        }
+
+        void SendNext() {
+            if (!HasNext()) {
+                Stop();
+                Host.OnConnectionFinished(*this);
+                return;
+            }
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            std::map<std::string, std::string> headers;
+            headers["Host"] = Host.Options.Host;
+            // Every connection is a separate client for the per client quota of the server
+            headers["X-Forwarded-For"] = "10.0." + std::to_string(Id / 256) + "." + std::to_string(Id % 256);
+            std::string startingLine, body;
+            if (Warmup || uniform(Rng) < Host.Options.SolveRatio) {
+                std::string cube;
+                if (Warmup) {
+                    cube = Pending.front();
+                    Route = R_SOLVE_HIT;
+                } else if (!Host.HotCubes.empty() && uniform(Rng) < Host.Options.CacheHitRatio) {
+                    cube = Host.HotCubes[std::uniform_int_distribution<size_t>(0, Host.HotCubes.size() - 1)(Rng)];
+                    Route = R_SOLVE_HIT;
+                } else {
+                    cube = Scramble(Rng, Host.Options.ScrambleDepth);
+                    Route = R_SOLVE_MISS;
+                }
+                startingLine = "GET /solve?cube=" + cube + " HTTP/1.1";
+            } else {
+                body = EncodeToBase64("{\"event\": \"load_test\", \"connection\": " + std::to_string(Id) + "}");
+                headers["Content-Length"] = std::to_string(body.size());
+                startingLine = "POST /log HTTP/1.1";
+                Route = R_LOG;
+            }
+            if (!Session)
+                Session = Connect(Host.Options.Host, Host.Options.Port, Host.IOService, THTTPRequestHandlerPtr(), std::make_shared<TOutgoingRequests>(true));
+            InFlight = true;
+            SendingTime = TClock::now();
+            Session->AddOutgoingRequest(Session, THTTPRequest(std::move(startingLine), std::move(headers), body), shared_from_this());
+        }
+};
+
+void TLoadGenerator::OnConnectionFinished(TConnection &connection) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    Finish = TClock::now();
+    if (--Active == 0)
+        IOService.stop();
+}
+
+// Connections stop sending at the deadline, the service is stopped when all of them are done
+// or a minute after the deadline if some replies never come.
+void TLoadGenerator::RunIOService(std::vector<TConnectionPtr> &connections, double limitSeconds) {
+    IOService.reset();
+    Deadline = TClock::now() + std::chrono::duration_cast<TClock::duration>(std::chrono::duration<double>(limitSeconds));
+    Active = connections.size();
+    boost::asio::steady_timer timer(IOService, Deadline + std::chrono::seconds(60));
+    timer.async_wait([this](const boost::system::error_code &error) {
+        if (!error)
+            IOService.stop();
+    });
+    for (auto &connection : connections)
+        IOService.post([connection]() { connection->Start(); });
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < Options.IOThreads; ++i)
+        threads.emplace_back([this]() { IOService.run(); });
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &connection : connections)
+        connection->Stop();
+}
+
+bool TLoadGenerator::Warmup() {
+    if (HotCubes.empty())
+        return true;
+    auto start = TClock::now();
+    std::vector<TConnectionPtr> connections(1, std::make_shared<TConnection>(*this, 0, true));
+    RunIOService(connections, 600);
+    size_t left = connections[0]->GetPendingCount();
+    std::cout << "Warmup: " << HotCubes.size() - left << "/" << HotCubes.size() << " hot cubes solved in "
+              << std::chrono::duration<double>(TClock::now() - start).count() << "s" << std::endl;
+    return left == 0;
+}
+
+void TLoadGenerator::Run() {
+    std::vector<TConnectionPtr> connections;
+    for (size_t i = 0; i < Options.Connections; ++i)
+        connections.push_back(std::make_shared<TConnection>(*this, i, false));
+    auto start = TClock::now();
+    Finish = start;
+    RunIOService(connections, Options.Duration);
+    double seconds = std::chrono::duration<double>(Finish - start).count();
+    for (auto &connection : connections) {
+        for (size_t route = 0; route < R_COUNT; ++route)
+            Stats[route].Merge(connection->GetStats(route));
+        if (connection->IsInFlight())
+            Stats[connection->GetRoute()].AddError();
+    }
+    TRouteStats total;
+    for (size_t route = 0; route < R_COUNT; ++route)
+        total.Merge(Stats[route]);
+    std::cout << std::fixed << std::setprecision(3) << Options.Connections << " connections, "
+              << (Options.KeepAlive ? "keep-alive" : "reconnecting") << ", " << seconds << "s" << std::endl;
+    total.Print("total", seconds);
+    Stats[R_SOLVE_HIT].Print("/solve cached", seconds);
+    Stats[R_SOLVE_MISS].Print("/solve fresh", seconds);
+    Stats[R_LOG].Print("/log", seconds);
+}
+
+
+class TApplication {
+public:
+    int Run(int argc, char *argv[]) {
+        if (!ParseCommandLine(argc, argv))
+            return 1;
+        TLoadGenerator generator(Options);
+        if (!generator.Warmup())
+            return 1;
+        generator.Run();
+        return 0;
+    }
+
+private:
+    TLoadOptions Options;
+
+private:
+    bool ParseCommandLine(int argc, char *argv[]) {
+        opt::options_description desc("Allowed options");
+        desc.add_options()
+            ("help",         "produce help message")
+            ("host",         opt::value<std::string>(&Options.Host)->default_value("localhost"), "server host")
+            ("port",         opt::value<int>(&Options.Port)->default_value(17071), "server port")
+            ("connections",  opt::value<size_t>(&Options.Connections)->default_value(16), "concurrent connections")
+            ("io-threads",   opt::value<size_t>(&Options.IOThreads)->default_value(1), "threads running the io service")
+            ("duration",     opt::value<double>(&Options.Duration)->default_value(10), "seconds to send requests")
+            ("requests",     opt::value<size_t>(&Options.Requests)->default_value(0), "total requests to send, 0 for no limit")
+            ("keep-alive",   opt::value<bool>(&Options.KeepAlive)->default_value(true), "reuse connections")
+            ("solve-ratio",  opt::value<double>(&Options.SolveRatio)->default_value(0.8), "share of /solve requests, the rest are /log")
+            ("hit-ratio",    opt::value<double>(&Options.CacheHitRatio)->default_value(0.9), "share of /solve requests for solved cubes")
+            ("hot-cubes",    opt::value<size_t>(&Options.HotCubes)->default_value(32), "cubes solved during warmup")
+            ("depth",        opt::value<size_t>(&Options.ScrambleDepth)->default_value(8), "scramble depth of generated cubes")
+            ("seed",         opt::value<unsigned>(&Options.Seed)->default_value(1), "random seed");
+
+        opt::variables_map vm;
+        opt::store(opt::parse_command_line(argc, argv, desc), vm);
+        opt::notify(vm);
+
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+};
+
+int main(int argc, char *argv[]) {
+    TApplication app;
+    return app.Run(argc, argv);
+}
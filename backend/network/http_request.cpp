@@ -309,6 +309,13 @@ void THTTPRequestBuilder::OnSymbol(char ch) {
     CurrentState = CurrentState->OnSymbol(ch, *this);
 }
 
+void THTTPRequestBuilder::Reset() {
+    StartingLine.clear();
+    Headers.clear();
+    ReadingStartingLineState.Init();
+    CurrentState = &ReadingStartingLineState;
+}
+
 void THTTPRequestBuilder::OnStartingLine(std::string &&line) {
     StartingLine.swap(line);
 }
@@ -60,6 +60,7 @@ public:
     explicit THTTPRequestBuilder(const THandler &handler);
 
     void OnSymbol(char ch);
+    void Reset();
     void OnStartingLine(std::string &&line);
     const std::string &GetStartingLine() const;
     void AddHeader(std::string &&name, std::string &&value);
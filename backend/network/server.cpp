@@ -2,6 +2,7 @@
 #include "session_http.h"
 #include "session_https.h"
 #include <chrono>
+#include <logger.h>
 
 
 //
@@ -14,8 +15,9 @@ TServer::TListenerInfo::TListenerInfo(boost::asio::io_service &ioService, bool i
 {
 }
 
-TServer::TServer()
+TServer::TServer(size_t sessionPoolSize)
     : ClientSSLContext(boost::asio::ssl::context::sslv23)
+    , SessionPool(std::make_shared<THTTPSessionPool>(IOService, sessionPoolSize))
 {
     ClientSSLContext.set_default_verify_paths();
 }
@@ -58,7 +60,7 @@ void TServer::Run() {
             {
                 std::unique_lock<std::mutex> lk(Mutex);
                 if (Exit) {
-                    std::cout << "Server is about to stop." << std::endl;
+                    LOGGER_INFO("Server is about to stop.");
                     break;
                 }
             }
@@ -69,9 +71,9 @@ void TServer::Run() {
             }
             GetIOService().run();
         } catch (const std::exception &ex) {
-            std::cerr << "Exception in TServer::Run: " << ex.what() << std::endl;
+            LOGGER_ERROR("Exception in TServer::Run: " << ex.what());
         } catch (...) {
-            std::cerr << "Exception in TServer::Run" << std::endl;
+            LOGGER_ERROR("Exception in TServer::Run");
         }
     }
 }
@@ -85,7 +87,7 @@ void TServer::Stop() {
 void TServer::StartAccept(TListenerInfoPtr listener) {
     TSessionPtr newSession;
     if (listener->SSLContext.get() == nullptr)
-        newSession.reset(new THTTPSession(GetIOService(), listener->MessageHandler, TOutgoingRequestsPtr()));
+        newSession = SessionPool->Acquire(listener->MessageHandler);
     else
         newSession.reset(new THTTPSSession(GetIOService(), *listener->SSLContext, listener->MessageHandler, TOutgoingRequestsPtr()));
     listener->Acceptor.async_accept(newSession->GetSocket(), [listener, newSession, this] (const boost::system::error_code &error) {
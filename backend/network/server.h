@@ -9,11 +9,12 @@
 #include <boost/asio/ssl.hpp>
 #include "http_request.h"
 #include "session.h"
+#include "session_pool.h"
 
 
 class TServer : private boost::noncopyable {
     public:
-        TServer();
+        explicit TServer(size_t sessionPoolSize = 256);
         ~TServer();
 
         boost::asio::io_service &GetIOService();
@@ -39,6 +40,7 @@ class TServer : private boost::noncopyable {
         boost::asio::io_service IOService;
         boost::asio::ssl::context ClientSSLContext;
         std::list<TListenerInfoPtr> Services;
+        THTTPSessionPoolPtr SessionPool;            // Recycled plain http sessions, https ones are always created anew
         std::mutex Mutex;
         bool Exit = false;
 
@@ -1,5 +1,28 @@
 #include "session.h"
-#include <iostream>
+#include "../util/metrics.h"
+#include <algorithm>
+#include <logger.h>
+
+
+namespace {
+    struct TSessionMetrics {
+        TCounter &BytesIn;
+        TCounter &BytesOut;
+        TGauge &ActiveSessions;
+        THistogram &ParseTime;
+
+        static TSessionMetrics &Instance() {
+            static TMetricsRegistry &registry = TMetricsRegistry::Instance();
+            static TSessionMetrics metrics{
+                registry.GetCounter("http_received_bytes_total", "Bytes read from sockets"),
+                registry.GetCounter("http_sent_bytes_total", "Bytes written to sockets"),
+                registry.GetGauge("http_active_sessions", "Connected sessions"),
+                registry.GetHistogram("http_request_parse_seconds", "Time from the first byte of a request to the parsed request")
+            };
+            return metrics;
+        }
+    };
+}
 
 
 //
@@ -52,15 +75,22 @@ THTTPReplyHandlerPtr TOutgoingRequests::PopReplyHandler() {
 
 void TOutgoingRequests::ResetAllSentRequests() {
     std::unique_lock<const TOutgoingRequests> lk(*this);
-    if (Sent.get() == nullptr)
+    if (Sent.get() == nullptr || Sent->empty())
         return;
-    std::cout << "Moving " << Sent->size() << " messages to Outgoing" << std::endl;
+    LOGGER_INFO("Moving " << Sent->size() << " messages to Outgoing");
     while (!Sent->empty()) {
         Outgoing.push_front(Sent->back());
         Sent->pop_back();
     }
 }
 
+void TOutgoingRequests::Clear() {
+    std::unique_lock<const TOutgoingRequests> lk(*this);
+    Outgoing.clear();
+    if (Sent.get() != nullptr)
+        Sent->clear();
+}
+
 
 //
 // TSession
@@ -70,7 +100,8 @@ TSession::TSession(
     THTTPRequestHandlerPtr requestHandler,
     TOutgoingRequestsPtr outgoing
 )
-    : ReadHandler([this](THTTPRequestPtr req) { HandleHTTP(req); })
+    : Data(INITIAL_LENGTH)
+    , ReadHandler([this](THTTPRequestPtr req) { HandleHTTP(req); })
     , RequestHandler(requestHandler)
     , Outgoing(outgoing)
 {
@@ -81,13 +112,43 @@ TSession::TSession(
 }
 
 TSession::~TSession() {
+    if (Connected)
+        TSessionMetrics::Instance().ActiveSessions.Add(-1);
+    if (RequestHandler.get())
+        RequestHandler->OnSessionDestroyed();
+}
+
+void TSession::Reset(THTTPRequestHandlerPtr requestHandler) {
     if (RequestHandler.get())
         RequestHandler->OnSessionDestroyed();
+    RequestHandler = requestHandler;
+    boost::system::error_code ec;
+    GetSocket().close(ec);
+    if (Connected)
+        TSessionMetrics::Instance().ActiveSessions.Add(-1);
+    Connected = false;
+    Parsing = false;
+    RemoteAddress.clear();
+    if (Data.size() > INITIAL_LENGTH)
+        std::vector<char>(INITIAL_LENGTH).swap(Data);
+    ReadHandler.Reset();
+    IncomingRequests.clear();
+    Outgoing->Clear();
+}
+
+const std::string &TSession::GetRemoteAddress() const {
+    return RemoteAddress;
 }
 
 void TSession::StartIO(TSessionPtr This) {
+    boost::system::error_code ec;
+    auto endpoint = GetSocket().remote_endpoint(ec);
+    if (!ec)
+        RemoteAddress = endpoint.address().to_string();
     {
         std::unique_lock<const TOutgoingRequests> lk(*Outgoing);
+        if (!Connected)
+            TSessionMetrics::Instance().ActiveSessions.Add(1);
         Connected = true;
         if (!Outgoing->IsEmpty())
             StartWriting(This);
@@ -109,16 +170,24 @@ void TSession::AddOutgoingRequest(TSessionPtr This, const THTTPRequest &response
         StartWriting(This);
 }
 
+void TSession::AddOutgoingData(TSessionPtr This, std::string data) {
+    std::unique_lock<const TOutgoingRequests> lk(*Outgoing);
+    bool writingInProgress = !Outgoing->IsEmpty();
+    Outgoing->AddRequest(std::move(data), THTTPReplyHandlerPtr());
+    if (!writingInProgress && Connected)
+        StartWriting(This);
+}
+
 TOutgoingRequestsPtr TSession::GetOutgoing() {
     return Outgoing;
 }
 
 char *TSession::GetData() {
-    return Data;
+    return Data.data();
 }
 
 size_t TSession::GetDataSize() const {
-    return MAX_LENGTH;
+    return Data.size();
 }
 
 void TSession::HandleRead(TSessionPtr This, const boost::system::error_code &error, size_t bytesTransferred) {
@@ -135,9 +204,16 @@ void TSession::HandleRead(TSessionPtr This, const boost::system::error_code &err
 
 void TSession::HandleReadUnsafe(TSessionPtr This, const boost::system::error_code &error, size_t bytesTransferred) {
     if (!error) {
+        TSessionMetrics::Instance().BytesIn.Add(bytesTransferred);
         for (int i = 0; i < bytesTransferred; ++i) {
+            if (!Parsing) {
+                Parsing = true;
+                ParsingStart = std::chrono::steady_clock::now();
+            }
             ReadHandler.OnSymbol(Data[i]);
         }
+        if (bytesTransferred == Data.size() && Data.size() < MAX_LENGTH)
+            Data.resize(std::min(Data.size() * 2, MAX_LENGTH));
         StartReading(This);
     } else {
         ReadHandler.OnSymbol(0);
@@ -145,6 +221,10 @@ void TSession::HandleReadUnsafe(TSessionPtr This, const boost::system::error_cod
 }
 
 void TSession::HandleHTTP(THTTPRequestPtr req) {
+    if (Parsing) {
+        TSessionMetrics::Instance().ParseTime.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - ParsingStart).count());
+        Parsing = false;
+    }
     IncomingRequests.push_back(req);
 }
 
@@ -164,6 +244,7 @@ void TSession::ProcessHTTPRequest(TSessionPtr This, THTTPRequestPtr req) {
 }
 
 void TSession::HandleWrite(TSessionPtr This, const boost::system::error_code& error, size_t bytesTransferred) {
+    TSessionMetrics::Instance().BytesOut.Add(bytesTransferred);
     std::unique_lock<const TOutgoingRequests> lk(*Outgoing);
     Outgoing->OnSendingFinished();
     if (!error) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <sstream>
 #include <list>
 #include <boost/asio.hpp>
@@ -45,6 +46,7 @@ class TOutgoingRequests : public TSynchronizable, private boost::noncopyable {
         void OnSendingFinished();
         THTTPReplyHandlerPtr PopReplyHandler();
         void ResetAllSentRequests();
+        void Clear();
 };
 
 using TOutgoingRequestsPtr = std::shared_ptr<TOutgoingRequests>;
@@ -66,11 +68,14 @@ public:
 
     virtual void Accept(TSessionPtr This) = 0;
     virtual void Connect(TSessionPtr This, TEndPointIterator endpoint_iterator) = 0;
+    virtual void Reset(THTTPRequestHandlerPtr requestHandler);    // Bring recycled session back to the just-constructed state
+    const std::string &GetRemoteAddress() const;                // Known after the connection is established
     void AddOutgoingRequest(
         TSessionPtr This,
         const THTTPRequest &response,
         THTTPReplyHandlerPtr replyHandler
     );
+    void AddOutgoingData(TSessionPtr This, std::string data);  // Bytes sent as is after the response queued before, e.g. body chunks
 
 protected:
     TOutgoingRequestsPtr GetOutgoing();
@@ -86,8 +91,12 @@ protected:
 
 private:
     bool Connected = false;
+    std::string RemoteAddress;
+    bool Parsing = false;                                       // Some bytes of the next request are read
+    std::chrono::steady_clock::time_point ParsingStart;
+    static constexpr size_t INITIAL_LENGTH = 4096;
     static constexpr size_t MAX_LENGTH = 65536;
-    char Data[MAX_LENGTH];
+    std::vector<char> Data;                                     // Grows twice when filled up to MAX_LENGTH
     THTTPRequestBuilder ReadHandler;
     std::list<THTTPRequestPtr> IncomingRequests;
     THTTPRequestHandlerPtr RequestHandler;
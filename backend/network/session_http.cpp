@@ -1,5 +1,5 @@
 #include "session_http.h"
-#include <iostream>
+#include <logger.h>
 
 
 //
@@ -39,7 +39,7 @@ void THTTPSession::HandleConnect(TSessionPtr This, const boost::system::error_co
     if (!error) {
         StartIO(This);
     } else {
-        std::cout << "Error in connect: " << error.message() << std::endl;
+        LOGGER_WARNING("Error in connect: " << error.message());
     }
 }
 
@@ -1,5 +1,5 @@
 #include "session_https.h"
-#include <iostream>
+#include <logger.h>
 
 
 //
@@ -63,7 +63,7 @@ void THTTPSSession::HandleConnect(TSessionPtr This, const boost::system::error_c
             }
         );
     } else {
-        std::cout << "Error in connect: " << error.message() << std::endl;
+        LOGGER_WARNING("Error in connect: " << error.message());
     }
 }
 
@@ -71,7 +71,7 @@ void THTTPSSession::HandleHandshake(TSessionPtr This, const boost::system::error
     if (!error) {
         StartIO(This);
     } else {
-        std::cout << "Error in handshake: " << error.message() << std::endl;
+        LOGGER_WARNING("Error in handshake: " << error.message());
     }
 }
 
@@ -0,0 +1,48 @@
+#include "session_pool.h"
+
+
+//
+// THTTPSessionPool
+//
+
+THTTPSessionPool::THTTPSessionPool(boost::asio::io_service &ioService, size_t maxSize)
+    : IOService(ioService)
+    , MaxSize(maxSize)
+{
+    Free.reserve(MaxSize);
+}
+
+THTTPSessionPool::~THTTPSessionPool() {
+}
+
+TSessionPtr THTTPSessionPool::Acquire(THTTPRequestHandlerPtr requestHandler) {
+    std::unique_ptr<THTTPSession> session;
+    {
+        std::unique_lock<std::mutex> lk(Mutex);
+        if (!Free.empty()) {
+            session = std::move(Free.back());
+            Free.pop_back();
+        }
+    }
+    if (session)
+        session->Reset(requestHandler);
+    else
+        session.reset(new THTTPSession(IOService, requestHandler, TOutgoingRequestsPtr()));
+    THTTPSessionPoolWeakPtr pool(shared_from_this());
+    return TSessionPtr(session.release(), [pool] (TSession *sess) {
+        THTTPSessionPoolPtr host(pool.lock());
+        if (host.get() == nullptr)
+            delete sess;
+        else
+            host->Release(static_cast<THTTPSession*>(sess));
+    });
+}
+
+void THTTPSessionPool::Release(THTTPSession *session) {
+    std::unique_ptr<THTTPSession> holder(session);
+    // Drop the handler and close the socket while the session is waiting in the pool
+    holder->Reset(THTTPRequestHandlerPtr());
+    std::unique_lock<std::mutex> lk(Mutex);
+    if (Free.size() < MaxSize)
+        Free.push_back(std::move(holder));
+}
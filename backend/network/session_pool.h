@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include "http_request.h"
+#include "session_http.h"
+
+
+/*
+    Keeps closed plain http sessions for reuse.
+    Acquired session is returned to the pool by the deleter of its shared pointer instead of being freed,
+    so accepting a connection does not allocate the session, its receive buffer and request builder again.
+*/
+class THTTPSessionPool : public std::enable_shared_from_this<THTTPSessionPool>, private boost::noncopyable {
+    public:
+        THTTPSessionPool(boost::asio::io_service &ioService, size_t maxSize);
+        ~THTTPSessionPool();
+
+        TSessionPtr Acquire(THTTPRequestHandlerPtr requestHandler);
+
+    private:
+        boost::asio::io_service &IOService;
+        size_t MaxSize = 0;
+        std::mutex Mutex;
+        std::vector<std::unique_ptr<THTTPSession>> Free;
+
+    private:
+        void Release(THTTPSession *session);
+};
+
+using THTTPSessionPoolPtr = std::shared_ptr<THTTPSessionPool>;
+using THTTPSessionPoolWeakPtr = std::weak_ptr<THTTPSessionPool>;
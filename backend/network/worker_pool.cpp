@@ -1,29 +1,56 @@
 #include "worker_pool.h"
+#include <algorithm>
 #include <chrono>
-#include <iostream>
+#include <logger.h>
 
 
 //
 // TWorkerPool
 //
 
-TWorkerPool::TWorkerPool(size_t threadCount, time_t secondsForShutdown)
+TWorkerPool::TWorkerPool(size_t threadCount, time_t secondsForShutdown, size_t maxQueueSize)
     : WorkingThreads(threadCount)
     , SecondsForShutdown(secondsForShutdown)
+    , MaxQueueSize(maxQueueSize)
 {
+    Events.resize(1);
 }
 
 TWorkerPool::~TWorkerPool() {
 }
 
-void TWorkerPool::AddEvent(const TEvent &event) {
+void TWorkerPool::SetPriorityLevels(size_t levelsCount, double agingSeconds) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    Events.resize(std::max<size_t>(levelsCount, 1));
+    AgingSeconds = agingSeconds;
+}
+
+void TWorkerPool::SetWaitHistogram(THistogram *histogram) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    WaitHistogram = histogram;
+}
+
+void TWorkerPool::AddEvent(const TEvent &event, size_t level) {
     {
         std::unique_lock<std::mutex> lk(Mutex);
-        Events.push_back(event);
+        PushEvent(event, level);
     }
     Condition.notify_one();                     // Notify working thread about new request
 }
 
+bool TWorkerPool::TryAddEvent(const TEvent &event, size_t level) {
+    {
+        std::unique_lock<std::mutex> lk(Mutex);
+        if (MaxQueueSize != 0 && EventsCount >= MaxQueueSize) {
+            ++Stats.Rejected;
+            return false;
+        }
+        PushEvent(event, level);
+    }
+    Condition.notify_one();
+    return true;
+}
+
 void TWorkerPool::Stop() {
     std::unique_lock<std::mutex> lk(Mutex);
     Exit = true;
@@ -41,15 +68,53 @@ void TWorkerPool::Join() {
         thread.join();
 }
 
+size_t TWorkerPool::GetThreadCount() const {
+    return WorkingThreads.size();
+}
+
+TWorkerPool::TStats TWorkerPool::GetStats() const {
+    std::unique_lock<std::mutex> lk(Mutex);
+    TStats result = Stats;
+    result.Queued = EventsCount;
+    return result;
+}
+
+void TWorkerPool::PushEvent(const TEvent &event, size_t level) {
+    Events[std::min(level, Events.size() - 1)].push_back({event, TClock::now()});
+    ++EventsCount;
+}
+
+TWorkerPool::TQueuedEvent TWorkerPool::PopEvent() {
+    // Take the front of the level with the best priority, aging lowers it by the time spent in the queue
+    TClock::time_point now = TClock::now();
+    size_t best = Events.size();
+    double bestScore = 0;
+    for (size_t i = 0; i < Events.size(); ++i) {
+        if (Events[i].empty())
+            continue;
+        double score = static_cast<double>(i);
+        if (AgingSeconds > 0)
+            score -= std::chrono::duration<double>(now - Events[i].front().QueueingTime).count() / AgingSeconds;
+        if (best == Events.size() || score < bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+    TQueuedEvent result(std::move(Events[best].front()));
+    Events[best].pop_front();
+    --EventsCount;
+    return result;
+}
+
 void TWorkerPool::WorkingThreadMethod() {
     for (; ;) {
         std::unique_lock<std::mutex> lk(Mutex);
-        while (!Exit && Events.empty()) {
+        while (!Exit && EventsCount == 0) {
             if (Condition.wait_for(lk, std::chrono::milliseconds(100)) == std::cv_status::timeout) {
             }
         }
         time_t shutdownTime = 0;
-        while (!Events.empty()) {
+        while (EventsCount != 0) {
             if (Exit) {
                 time_t currentTime = time(nullptr);
                 if (shutdownTime == 0)
@@ -57,13 +122,19 @@ void TWorkerPool::WorkingThreadMethod() {
                 if (shutdownTime >= currentTime)
                     break;
             }
-            auto event = Events.front();
-            Events.pop_front();
+            TQueuedEvent queued = PopEvent();
+            auto event = std::move(queued.Event);
+            double wait = std::chrono::duration<double>(TClock::now() - queued.QueueingTime).count();
+            ++Stats.Processed;
+            Stats.TotalWaitSeconds += wait;
+            Stats.MaxWaitSeconds = std::max(Stats.MaxWaitSeconds, wait);
+            if (WaitHistogram)
+                WaitHistogram->Observe(wait);
             lk.unlock();
             try {
                 event();
             } catch (...) {
-                std::cerr << "Exception in TWorkerPool::WorkingThreadMethod, event()" << std::endl;
+                LOGGER_ERROR("Exception in TWorkerPool::WorkingThreadMethod, event()");
             }
             lk.lock();
         }
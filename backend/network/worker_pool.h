@@ -3,39 +3,70 @@
 #include <iostream>
 #include <fstream>
 #include <list>
+#include <chrono>
 #include <condition_variable>
 #include <thread>
 #include <functional>
 #include "http_request.h"
 #include "session.h"
+#include "../util/metrics.h"
 
 
 /*
     Object with N working threads.
     Gets request from processing queue and executes it when there is a free thread.
+    Queue may be bounded, then TryAddEvent refuses new events when it is full.
+    Events have priority levels, 0 is the most urgent. With aging an event gains one level
+    for every AgingSeconds it waits, so low priority events are not starved.
 */
 class TWorkerPool : private boost::noncopyable {
     public:
         using TEvent = std::function<void()>;
+        using TClock = std::chrono::steady_clock;
 
-        TWorkerPool(size_t threadCount, time_t secondsForShutdown);
+        struct TStats {
+            size_t Queued = 0;                      // Events waiting in the queue right now
+            size_t Processed = 0;                   // Events taken by working threads
+            size_t Rejected = 0;                    // Events refused by TryAddEvent
+            double TotalWaitSeconds = 0;            // Time spent in the queue by processed events
+            double MaxWaitSeconds = 0;
+        };
+
+        TWorkerPool(size_t threadCount, time_t secondsForShutdown, size_t maxQueueSize = 0);    // 0 means unbounded
         ~TWorkerPool();
 
-        void AddEvent(const TEvent &event);
+        void SetPriorityLevels(size_t levelsCount, double agingSeconds);   // Call before Run
+        void SetWaitHistogram(THistogram *histogram);                       // Call before Run
+        void AddEvent(const TEvent &event, size_t level = 0);
+        bool TryAddEvent(const TEvent &event, size_t level = 0);        // false if the queue is full
         void Stop();
         void Run();
         void Join();
+        size_t GetThreadCount() const;
+        TStats GetStats() const;
 
     private:
-        std::mutex Mutex;
+        struct TQueuedEvent {
+            TEvent Event;
+            TClock::time_point QueueingTime;
+        };
+
+        mutable std::mutex Mutex;
         std::condition_variable Condition;
-        std::list<TEvent> Events;
+        std::vector<std::list<TQueuedEvent>> Events;  // By priority level
+        size_t EventsCount = 0;
+        double AgingSeconds = 0;
         bool Exit = false;
         std::vector<std::thread> WorkingThreads;
         time_t SecondsForShutdown = 0;
+        size_t MaxQueueSize = 0;
+        TStats Stats;
+        THistogram *WaitHistogram = nullptr;
 
     private:
         void WorkingThreadMethod();
+        void PushEvent(const TEvent &event, size_t level);          // Mutex should be locked
+        TQueuedEvent PopEvent();                                    // Mutex should be locked
 };
 using TWorkerPoolPtr = std::shared_ptr<TWorkerPool>;
 using TWorkerPoolWeakPtr = std::weak_ptr<TWorkerPool>;
@@ -0,0 +1,34 @@
+#include "client_quota.h"
+
+
+//
+// TClientQuota
+//
+
+TClientQuota::TClientQuota(size_t maxPerClient)
+    : MaxPerClient(maxPerClient)
+{
+}
+
+void TClientQuota::SetMaxPerClient(size_t maxPerClient) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    MaxPerClient = maxPerClient;
+}
+
+bool TClientQuota::TryAcquire(const std::string &client) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    size_t &count = InFlight[client];
+    if (MaxPerClient != 0 && count >= MaxPerClient)
+        return false;
+    ++count;
+    return true;
+}
+
+void TClientQuota::Release(const std::string &client) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    auto it = InFlight.find(client);
+    if (it == InFlight.end())
+        return;
+    if (--it->second == 0)
+        InFlight.erase(it);
+}
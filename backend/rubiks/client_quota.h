@@ -0,0 +1,25 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+
+
+/*
+    Limits the number of solves every client may have in flight at once,
+    so that a single client can not fill the whole solver queue.
+*/
+class TClientQuota : private boost::noncopyable {
+    public:
+        explicit TClientQuota(size_t maxPerClient = 0);    // 0 means unlimited
+
+        void SetMaxPerClient(size_t maxPerClient);
+        bool TryAcquire(const std::string &client);
+        void Release(const std::string &client);
+
+    private:
+        std::mutex Mutex;
+        std::unordered_map<std::string, size_t> InFlight;
+        size_t MaxPerClient = 0;
+};
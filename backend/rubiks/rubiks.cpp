@@ -1,14 +1,17 @@
 #include "rubiks.h"
 #include "../dist/json/json.h"
 #include "../network/session_http.h"
-#include "../util/json.h"
 #include "../util/url.h"
 #include "../util/random_util.h"
-#include <fstream>
 #include <cube.h>
 #include <kociemba.h>
-#include <sstream>
+#include <logger.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <ctime>
+#include <mutex>
+#include <sstream>
 
 
 //
@@ -35,31 +38,104 @@ void TRubiks::Init(const Json::Value &data)
             }
     };
 
-    Server = std::make_shared<TServer>();
+    TLogger::Instance().SetLevel(ParseLogLevel(data.get("console_log_level", "info").asString()));
+    Server = std::make_shared<TServer>(data.get("session_pool_size", 256).asInt());
     WorkerPool = std::make_shared<TWorkerPool>(data.get("worker_count", 10).asInt(), data.get("seconds_for_shutdown", 30).asInt());
-    SolverPool = std::make_shared<TWorkerPool>(data.get("solver_count", 1).asInt(), data.get("seconds_for_shutdown", 30).asInt());
-    LogPath = data.get("log_path", "data/rubiks.log").asString();
-    LogFlushInterval = data.get("log_flush_interval", 10).asInt();
-    LogFillingThreshold = data.get("log_filling_threshold", 100).asInt();
-    LogLastFlushingTime = 0;
+    SolverPool = std::make_shared<TWorkerPool>(data.get("solver_count", 1).asInt(), data.get("seconds_for_shutdown", 30).asInt(),
+                                               data.get("solver_queue_size", 1000).asInt());
+    ClientQuota.SetMaxPerClient(data.get("max_pending_per_client", 20).asInt());
+    RetryAfter = data.get("retry_after", 5).asInt();
+    MaxBatchSize = data.get("max_batch_size", 10000).asUInt();
+    InvalidCube = std::make_shared<TSolveState>();
+    InvalidCube->Finish(false, std::vector<ETurnExt>());
+    TablesDir = data.get("tables_dir", "").asString();
+    ReduceOptions.WindowSize = data.get("reduce_window_size", 0).asUInt();
+    ReduceOptions.MaxNodesExpanded = data.get("reduce_max_nodes", 20000).asUInt();
+    ReduceOptions.ThreadsCount = data.get("reduce_thread_count", 2).asUInt();
+    const Json::Value &thresholds = data["solver_cost_thresholds"];
+    if (thresholds.isArray()) {
+        for (const auto &threshold : thresholds)
+            CostThresholds.push_back(threshold.asInt());
+    } else {
+        CostThresholds.push_back(4);
+    }
+    SolverPool->SetPriorityLevels(CostThresholds.size() + 1, data.get("solver_aging_seconds", 10).asDouble());
+    TLogWriter::TOptions logOptions;
+    logOptions.Path = data.get("log_path", "data/rubiks.log").asString();
+    logOptions.QueueSize = data.get("log_queue_size", 65536).asInt();
+    logOptions.FlushInterval = data.get("log_flush_interval", 10).asInt();
+    logOptions.FillingThreshold = data.get("log_filling_threshold", 100).asInt();
+    logOptions.RotationSize = data.get("log_rotation_size", 0).asUInt64();
+    logOptions.RotationInterval = data.get("log_rotation_interval", 0).asInt();
+    LogWriter = std::make_shared<TLogWriter>(logOptions);
     auto httpHandler = std::make_shared<TServiceDispatcher>(*this, &TRubiks::ProcessHTTP);
     auto httpForwarder = std::make_shared<TWorkerHTTPRequestHandler>(WorkerPool, httpHandler);
     HttpPort = data.get("http_port", 17071).asInt();
     Server->AddHTTPService(false, HttpPort, httpForwarder);
+    InitMetrics();
 }
 
-void TRubiks::Run() {
-    InitKociemba();
-    MainThread = std::thread([this]() {
-        MainThreadMethod();
+void TRubiks::InitMetrics() {
+    TMetricsRegistry &registry = TMetricsRegistry::Instance();
+    static const char *ROUTES[R_COUNT] = {"solve", "solve_batch", "log", "metrics", "exit", "other"};
+    for (size_t route = 0; route < R_COUNT; ++route)
+        RouteRequests[route] = &registry.GetCounter("rubiks_requests_total", "HTTP requests by route",
+                                                    std::string("route=\"") + ROUTES[route] + "\"");
+    CacheHits = &registry.GetCounter("rubiks_cache_hits_total", "Solves answered from the cache or joined to a solve in flight");
+    CacheMisses = &registry.GetCounter("rubiks_cache_misses_total", "Solves not found in the cache");
+    CacheEvictions = &registry.GetCounter("rubiks_cache_evictions_total", "Cache entries removed");
+    SolveTime = &registry.GetHistogram("rubiks_solve_seconds", "Time of the solver run");
+    registry.AddCallback("rubiks_cache_entries", "Solved and pending cubes in the cache", false, [this]() {
+        return static_cast<double>(Solutions.Size());
+    });
+    const std::pair<const char *, TWorkerPoolPtr> pools[] = { {"worker", WorkerPool}, {"solver", SolverPool} };
+    for (const auto &it : pools) {
+        std::string labels = std::string("pool=\"") + it.first + "\"";
+        TWorkerPoolPtr pool = it.second;
+        pool->SetWaitHistogram(&registry.GetHistogram("rubiks_queue_wait_seconds", "Time spent by events in the queue of the pool", labels));
+        registry.AddCallback("rubiks_queue_length", "Events waiting in the queue of the pool", false, [pool]() {
+            return static_cast<double>(pool->GetStats().Queued);
+        }, labels);
+        registry.AddCallback("rubiks_queue_processed_total", "Events taken by the threads of the pool", true, [pool]() {
+            return static_cast<double>(pool->GetStats().Processed);
+        }, labels);
+        registry.AddCallback("rubiks_queue_rejected_total", "Events refused because the queue of the pool was full", true, [pool]() {
+            return static_cast<double>(pool->GetStats().Rejected);
+        }, labels);
+    }
+    TLogWriterPtr logWriter = LogWriter;
+    registry.AddCallback("rubiks_log_records_total", "Log records by outcome", true, [logWriter]() {
+        return static_cast<double>(logWriter->GetWrittenCount());
+    }, "state=\"written\"");
+    registry.AddCallback("rubiks_log_records_total", "Log records by outcome", true, [logWriter]() {
+        return static_cast<double>(logWriter->GetDroppedCount());
+    }, "state=\"dropped\"");
+    registry.AddCallback("rubiks_log_records_total", "Log records by outcome", true, [logWriter]() {
+        return static_cast<double>(logWriter->GetFailedCount());
+    }, "state=\"failed\"");
+    registry.AddCallback("rubiks_log_rotations_total", "Rotations of the log file", true, [logWriter]() {
+        return static_cast<double>(logWriter->GetRotationsCount());
     });
+}
+
+void TRubiks::Run() {
+    InitKociemba(TablesDir);
     ServiceThread = std::thread([this]() {
+        LogWriter->Run();
         WorkerPool->Run();
         SolverPool->Run();
         Server->Run();
         WorkerPool->Join();
         SolverPool->Join();
-        MainThread.join();
+        // Solves left in the queue of the stopped pool never run, their waiters (batches) get busy
+        auto pending = Solutions.Select([](const TSolveStatePtr &state) { return state->GetStatus() == SS_PENDING; });
+        for (const TSolveStatePtr &state : pending)
+            state->Reject();
+        LogWriter->Join();
+        TWorkerPool::TStats stats = SolverPool->GetStats();
+        LOGGER_INFO("Solver pool: " << stats.Processed << " processed, " << stats.Rejected << " rejected, average wait "
+                    << (stats.Processed ? stats.TotalWaitSeconds / stats.Processed : 0.0) << "s, max wait " << stats.MaxWaitSeconds << "s");
+        TLogger::Instance().Flush();
     });
 }
 
@@ -67,40 +143,85 @@ void TRubiks::Join() {
     ServiceThread.join();
 }
 
-void TRubiks::ProcessHTTP(TSessionPtr session, THTTPRequestPtr req) {
-    {
-        std::unique_lock<std::mutex> lk(Mutex);
-        if (Exit)
-            return;
+static std::string GetStatusLine(int code) {
+    switch (code) {
+        case 200:
+            return "HTTP/1.1 200 OK";
+        case 429:
+            return "HTTP/1.1 429 Too Many Requests";
+        case 503:
+            return "HTTP/1.1 503 Service Unavailable";
+        default:
+            return "HTTP/1.1 400 Bad Request";
     }
+}
+
+// Requests from the frontend come through the proxy, so the real address is in X-Forwarded-For
+static std::string GetClient(const TSession &session, const THTTPRequest &req) {
+    auto it = req.GetHeaders().find("X-Forwarded-For");
+    if (it != req.GetHeaders().end() && !it->second.empty())
+        return it->second.substr(0, it->second.find(','));
+    return session.GetRemoteAddress();
+}
+
+void TRubiks::ProcessHTTP(TSessionPtr session, THTTPRequestPtr req) {
+    if (Exit)
+        return;
     std::string method, url, protocol, resource;
     SplitStartingLine(req->GetStartingLine(), method, url, protocol);
     TUrlCgiParams params;
     ParseUrlResource(url, resource, params);
-    bool result = true;
-    Json::Value data;
+    int code = 200;
+    std::map<std::string, std::string> headers;
+    std::string body;
+    TJsonWriter json(body);
     if (url == "/exit") {
+        RouteRequests[R_EXIT]->Add();
         Stop();
     } else if (resource == "/solve") {
-        result = Solve(params, data);
+        RouteRequests[R_SOLVE]->Add();
+        code = Solve(params, GetClient(*session, *req), json);
+    } else if (resource == "/solve_batch") {
+        RouteRequests[R_SOLVE_BATCH]->Add();
+        if (SolveBatch(session, *req))
+            return;
+        code = 400;
     } else if (resource == "/log") {
-        result = LogEvent(req->GetBodyStr(), data);
+        RouteRequests[R_LOG]->Add();
+        code = LogEvent(req->GetBodyStr(), json) ? 200 : 400;
+    } else if (resource == "/metrics") {
+        RouteRequests[R_METRICS]->Add();
+        body = TMetricsRegistry::Instance().Render();
+        headers["Content-Type"] = "text/plain; version=0.0.4";
     } else {
-        result = false;
+        RouteRequests[R_OTHER]->Add();
+        code = 400;
     }
-    std::map<std::string, std::string> headers;
-    std::string json = SaveJson(data);
-    headers["Content-Length"] = boost::lexical_cast<std::string>(json.size());
-    THTTPRequest response(std::string(result ? "HTTP/1.1 200 OK" : "HTTP/1.1 400 Bad Request"), std::move(headers), json);
-    session->AddOutgoingRequest(session, response, THTTPReplyHandlerPtr());
+    if (body.empty())
+        body = "null";
+    if (code == 429 || code == 503)
+        headers["Retry-After"] = boost::lexical_cast<std::string>(RetryAfter);
+    // The response is formatted in one string, which goes to the session as is
+    std::string response = GetStatusLine(code);
+    response.reserve(response.size() + body.size() + 128);
+    response += "\r\n";
+    for (const auto &header : headers) {
+        response += header.first;
+        response += ": ";
+        response += header.second;
+        response += "\r\n";
+    }
+    response += "Content-Length: ";
+    response += std::to_string(body.size());
+    response += "\r\n\r\n";
+    response += body;
+    session->AddOutgoingData(session, std::move(response));
 }
 
 bool TRubiks::Stop() {
     Server->Stop();
     WorkerPool->Stop();
-    std::unique_lock<std::mutex> lk(Mutex);
     Exit = true;
-    Condition.notify_all();
     return true;
 }
 
@@ -111,92 +232,258 @@ class TPrintHandler : public THTTPReplyHandler {
         }
 };
 
-void TRubiks::MainThreadMethod() {
-    for (; ;) {
-        std::unique_lock<std::mutex> lk(Mutex);
-        if (!Exit && LogRecords.size() < LogFillingThreshold && LogLastFlushingTime + LogFlushInterval >= time(nullptr))
-            Condition.wait_for(lk, std::chrono::milliseconds(100));
-        if (LogRecords.size() >= LogFillingThreshold || LogLastFlushingTime + LogFlushInterval < time(nullptr))
-            FlushLog();
-        if (Exit)
-            return;
+static void WriteSolveStats(TJsonWriter &json, const TSolveStats &stats) {
+    json.BeginObject();
+    json.Key("seconds").Number(stats.Seconds);
+    json.Key("turns_saved").Number(static_cast<uint64_t>(stats.TurnsSaved));
+    json.Key("reduce_seconds").Number(stats.ReduceSeconds);
+    json.Key("stages").BeginArray();
+    for (const TStageStats &stage : stats.Stages) {
+        json.BeginObject();
+        json.Key("nodes_expanded").Number(static_cast<uint64_t>(stage.NodesExpanded));
+        json.Key("nodes_generated").Number(static_cast<uint64_t>(stage.NodesGenerated));
+        json.Key("hash_lookups").Number(static_cast<uint64_t>(stage.HashLookups));
+        json.Key("backward_hits").Number(static_cast<uint64_t>(stage.BackwardHits));
+        json.Key("backward_filtered").Number(static_cast<uint64_t>(stage.BackwardFiltered));
+        json.Key("pruned_by_depth").Number(static_cast<uint64_t>(stage.PrunedByDepth));
+        json.Key("pruned_by_estimator").BeginArray();
+        for (size_t count : stage.PrunedByEstimator)
+            json.Number(static_cast<uint64_t>(count));
+        json.EndArray();
+        json.Key("candidates").Number(static_cast<uint64_t>(stage.Candidates));
+        json.Key("peak_reached_size").Number(static_cast<uint64_t>(stage.PeakReachedSize));
+        json.Key("seconds").Number(stage.Seconds);
+        json.EndObject();
     }
-    std::cout << "End of MainThreadMethod" << std::endl;
+    json.EndArray();
+    json.EndObject();
 }
 
-bool TRubiks::Solve(const TUrlCgiParams &params, Json::Value &data) {
+int TRubiks::Solve(const TUrlCgiParams &params, const std::string &client, TJsonWriter &json) {
     if (params.empty())
-        return false;
+        return 400;
     std::string cube;
+    bool withStats = false;
     for (const auto &param : params) {
         if (param.first == "cube")
             cube = param.second;
+        else if (param.first == "stats")
+            withStats = (param.second == "1" || param.second == "true");
     }
     if (cube.empty())
-        return false;
-    std::cout << "solving " << cube << std::endl;
-    std::unique_lock<std::mutex> lk(Mutex);
-    auto it = Solutions.find(cube);
-    if (it == Solutions.end()) {
-        Solutions[cube] = "pending";
-        auto *mtx = &Mutex;
-        auto *solutions = &Solutions;
-        SolverPool->AddEvent([cube, mtx, solutions]() {
-            try {
-                TCube puzzle = MakePuzzle(cube);
-                std::vector<ETurnExt> solution;
-                if (!KociembaSolution(puzzle, solution))
-                    throw std::logic_error("no solution");
-                std::stringstream str;
-                str << "[";
-                for (size_t i = 0; i < solution.size(); ++i) {
-                    if (i > 0)
-                        str << ",";
-                    str << "\"" << TurnExt2String(solution[i]) << "\"";
-                }
-                str << "]";
-                std::unique_lock<std::mutex> lk(*mtx);
-                (*solutions)[cube] = str.str();
-            } catch (...) {
-                std::unique_lock<std::mutex> lk(*mtx);
-                (*solutions)[cube] = "no solution";
-            }
-        });
-        it = Solutions.find(cube);
+        return 400;
+    LOGGER_DEBUG("solving " << cube);
+    TSolveStatePtr state = StartSolving(cube, client);
+    json.BeginObject();
+    if (!state) {
+        json.Key("state").String("busy").EndObject();
+        return 429;
     }
-    std::cout << "result is " << it->second << std::endl;
-    if (it->second == "pending") {
-        data["state"] = "pending";
-    } else if (it->second == "no solution") {
-        data["state"] = "fail";
-    } else {
-        data["state"] = "ok";
-        data["result"] = it->second;
+    ESolveStatus status = state->GetStatus();
+    switch (status) {
+        case SS_PENDING:
+            json.Key("state").String("pending");
+            break;
+        case SS_FAIL:
+            json.Key("state").String("fail");
+            break;
+        case SS_OK:
+            json.Key("state").String("ok");
+            json.Key("result").Raw(state->GetSolutionStr());
+            break;
+        case SS_REJECTED:
+            json.Key("state").String("busy").EndObject();
+            return 503;
     }
-    return true;
+    if (withStats && status != SS_PENDING) {
+        json.Key("stats");
+        WriteSolveStats(json, state->GetStats());
+    }
+    json.EndObject();
+    LOGGER_DEBUG("result is " << static_cast<int>(status));
+    return 200;
 }
 
-bool TRubiks::LogEvent(const std::string &event, Json::Value &data) {
-    if (event.empty())
+/*
+    Cubes of one /solve_batch request. They are started a few at a time within the quota of the client,
+    every finished solve sends its result as a chunk of the response and starts the next cubes.
+*/
+struct TRubiks::TBatch {
+    TSessionPtr Session;
+    std::string Client;
+    std::vector<std::string> Cubes;                         // As given, parsed when started
+    std::mutex Mutex;
+    size_t Started = 0;
+    size_t InFlight = 0;
+    size_t Finished = 0;
+    bool Pumping = false;                                   // Some thread is starting cubes
+    bool PumpAgain = false;                                 // Solves finished while cubes were being started
+};
+
+static void WriteChunk(const TSessionPtr &session, const std::string &data) {
+    std::ostringstream chunk;
+    chunk << std::hex << data.size() << "\r\n" << data << "\r\n";
+    session->AddOutgoingData(session, chunk.str());
+}
+
+// POST body has a cube on every non-empty line, results are json lines with the index of the cube, in order of finishing
+bool TRubiks::SolveBatch(TSessionPtr session, const THTTPRequest &req) {
+    std::string method, url, protocol;
+    SplitStartingLine(req.GetStartingLine(), method, url, protocol);
+    if (method != "POST")
+        return false;
+    auto batch = std::make_shared<TBatch>();
+    batch->Session = session;
+    batch->Client = GetClient(*session, req);
+    std::istringstream body(req.GetBodyStr());
+    std::string line;
+    while (std::getline(body, line)) {
+        line.erase(std::remove_if(line.begin(), line.end(), [](char ch) { return isspace(static_cast<unsigned char>(ch)); }), line.end());
+        if (!line.empty())
+            batch->Cubes.push_back(std::move(line));
+    }
+    if (batch->Cubes.empty() || batch->Cubes.size() > MaxBatchSize)
         return false;
-    std::unique_lock<std::mutex> lk(Mutex);
-    LogRecords.push_back(event);
-    data["state"] = "ok";
+    std::map<std::string, std::string> headers;
+    headers["Content-Type"] = "application/x-ndjson";
+    headers["Transfer-Encoding"] = "chunked";
+    session->AddOutgoingRequest(session, THTTPRequest(GetStatusLine(200), std::move(headers), std::string()), THTTPReplyHandlerPtr());
+    PumpBatch(batch);
     return true;
 }
 
-void TRubiks::FlushLog() {
-    LogLastFlushingTime = time(nullptr);
-    if (LogRecords.empty())
+// Starts cubes of the batch until the quota of the client is used up, one thread at a time.
+// Solves in flight finish their cubes and pump again, so a batch is pumped until all its cubes are answered.
+void TRubiks::PumpBatch(const TBatchPtr &batch) {
+    std::unique_lock<std::mutex> lk(batch->Mutex);
+    if (batch->Pumping) {
+        batch->PumpAgain = true;
         return;
-    auto records = std::make_shared<std::vector<std::string>>(std::move(LogRecords));
-    std::mutex *mtx = &LogFlushMutex;
-    std::string path = LogPath;
-    WorkerPool->AddEvent([records, mtx, path]() {
-        std::unique_lock<std::mutex> lk(*mtx);
-        std::ofstream fout(path, std::ios_base::app | std::ios_base::out);
-        for (const auto &event : *records)
-            fout << event << '\n';
-    });
+    }
+    batch->Pumping = true;
+    do {
+        batch->PumpAgain = false;
+        while (batch->Started < batch->Cubes.size() && !Exit) {
+            size_t index = batch->Started;
+            lk.unlock();
+            TSolveStatePtr state = StartSolving(batch->Cubes[index], batch->Client);
+            lk.lock();
+            // Solves of the batch in flight release the quota, the cube is busy only if nothing else will
+            if (!state && batch->InFlight != 0)
+                break;
+            ++batch->Started;
+            ++batch->InFlight;
+            lk.unlock();
+            if (state)
+                state->Subscribe([this, batch, index](const TSolveState &finished) {
+                    FinishBatchCube(batch, index, &finished);
+                    PumpBatch(batch);
+                });
+            else
+                FinishBatchCube(batch, index, nullptr);
+            lk.lock();
+        }
+        // On shutdown the cubes not started are answered busy, so the response still gets its last chunk
+        while (Exit && batch->Started < batch->Cubes.size()) {
+            size_t index = batch->Started++;
+            ++batch->InFlight;
+            lk.unlock();
+            FinishBatchCube(batch, index, nullptr);
+            lk.lock();
+        }
+    } while (batch->PumpAgain);
+    batch->Pumping = false;
+}
+
+// Sends the result of the cube, nullptr state for the cube refused by the quota
+void TRubiks::FinishBatchCube(const TBatchPtr &batch, size_t index, const TSolveState *state) {
+    ESolveStatus status = state ? state->GetStatus() : SS_REJECTED;
+    std::string line;
+    TJsonWriter json(line);
+    json.BeginObject();
+    json.Key("index").Number(static_cast<uint64_t>(index));
+    json.Key("state").String(status == SS_OK ? "ok" : status == SS_FAIL ? "fail" : "busy");
+    if (status == SS_OK)
+        json.Key("result").Raw(state->GetSolutionStr());
+    json.EndObject();
+    line += '\n';
+    WriteChunk(batch->Session, line);
+    std::unique_lock<std::mutex> lk(batch->Mutex);
+    --batch->InFlight;
+    if (++batch->Finished == batch->Cubes.size())
+        batch->Session->AddOutgoingData(batch->Session, "0\r\n\r\n");
 }
 
+// Strings that are no cubes fail at once and are not cached, the same for cubes the estimators reject below
+TSolveStatePtr TRubiks::StartSolving(const std::string &cube, const std::string &client) {
+    TCubeKey key;
+    if (!ParseCubeKey(cube, key))
+        return InvalidCube;
+    return StartSolving(key, client);
+}
+
+// Returns the state of the solve for the cube, the solver is started only by the first request.
+// Returns nothing when the client has too many solves in flight.
+TSolveStatePtr TRubiks::StartSolving(const TCubeKey &key, const std::string &client) {
+    TSolveStatePtr state;
+    if (Solutions.Get(key, state)) {
+        CacheHits->Add();
+        state->AddWaiter();
+        return state;
+    }
+    CacheMisses->Add();
+    TCube puzzle;
+    puzzle.SetImage(key);
+    int estimate = KociembaEstimate(puzzle);
+    if (estimate < 0)
+        return InvalidCube;
+    if (!ClientQuota.TryAcquire(client))
+        return TSolveStatePtr();
+    size_t level = GetCostLevel(estimate);
+    bool started = Solutions.Emplace(key, std::make_shared<TSolveState>(level), state);
+    state->AddWaiter();
+    if (!started) {
+        ClientQuota.Release(client);
+        return state;
+    }
+    auto *quota = &ClientQuota;
+    THistogram *solveTime = SolveTime;
+    const TReduceOptions *reduce = ReduceOptions.WindowSize != 0 ? &ReduceOptions : nullptr;
+    bool queued = SolverPool->TryAddEvent([puzzle, client, state, quota, solveTime, reduce]() {
+        std::vector<ETurnExt> solution;
+        TSolveStats stats;
+        bool success = false;
+        auto start = std::chrono::steady_clock::now();
+        try {
+            success = KociembaSolution(puzzle, solution, &stats, reduce);
+        } catch (...) {
+            success = false;
+        }
+        solveTime->Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        quota->Release(client);
+        state->Finish(success, std::move(solution), stats);
+    }, level);
+    if (!queued) {
+        // Forget the cube, so it is solved when asked again after the queue drains
+        ClientQuota.Release(client);
+        if (Solutions.Erase(key))
+            CacheEvictions->Add();
+        state->Reject();
+    }
+    return state;
+}
+
+// Cheap solves go to the first levels of the solver queue, thresholds are for the estimate of the first stage
+size_t TRubiks::GetCostLevel(int estimate) const {
+    size_t level = 0;
+    while (level < CostThresholds.size() && estimate >= CostThresholds[level])
+        ++level;
+    return level;
+}
+
+bool TRubiks::LogEvent(const std::string &event, TJsonWriter &json) {
+    if (event.empty())
+        return false;
+    json.BeginObject().Key("state").String(LogWriter->Write(event) ? "ok" : "dropped").EndObject();
+    return true;
+}
@@ -5,12 +5,20 @@
 #include "../network/session.h"
 #include "../network/server.h"
 #include "../network/worker_pool.h"
+#include "../util/json_writer.h"
+#include "../util/log_writer.h"
+#include "../util/metrics.h"
+#include "../util/sharded_map.h"
 #include "../util/url.h"
+#include "client_quota.h"
+#include "solve_state.h"
+#include <kociemba.h>
 #include <boost/noncopyable.hpp>
+#include <atomic>
+#include <map>
 #include <string>
 #include <thread>
-#include <condition_variable>
-#include <map>
+#include <vector>
 
 
 class TRubiks : private boost::noncopyable {
@@ -20,33 +28,55 @@ class TRubiks : private boost::noncopyable {
         void Join();
 
     private:
-        using TSolutions = std::map<std::string, std::string>;
+        using TSolutions = TShardedMap<TCubeKey, TSolveStatePtr, TCubeKeyHash>;
+        struct TBatch;
+        using TBatchPtr = std::shared_ptr<TBatch>;
+
+        enum ERoute {
+            R_SOLVE,
+            R_SOLVE_BATCH,
+            R_LOG,
+            R_METRICS,
+            R_EXIT,
+            R_OTHER,
+            R_COUNT
+        };
 
         // Threads and network processors
         TServerPtr Server;
         TWorkerPoolPtr WorkerPool;
         TWorkerPoolPtr SolverPool;
-        std::thread MainThread;
+        TLogWriterPtr LogWriter;
         std::thread ServiceThread;
         // Constants initialized before work
         int HttpPort = 0;
+        int RetryAfter = 0;                                 // Seconds to wait after the solver refused the request
+        size_t MaxBatchSize = 0;                            // Cubes in one /solve_batch request
+        std::vector<int> CostThresholds;                    // Estimates separating priority levels of the solver queue
+        std::string TablesDir;                              // Saved tables of the solver, empty to build them every start
+        TReduceOptions ReduceOptions;                       // Post-pass over solutions, off with the window of 0
         // Runtime objects
-        mutable std::mutex Mutex;                           // Guards all runtime objects
-        std::condition_variable Condition;                  // Condition for wake up MainThread
-        bool Exit = false;                                  // Flag to stop all processes
-        TSolutions Solutions;                               // Cached solutions
-        std::vector<std::string> LogRecords;                // Strings to write into log
-        std::string LogPath;                                // Path to log file
-        std::mutex LogFlushMutex;                           // Mutex protecting log file
-        size_t LogFlushInterval = 0;                        // How often flush the log
-        size_t LogFillingThreshold = 0;                     // Number of log records after which flushing is needed anyway
-        time_t LogLastFlushingTime = 0;                     // Last time the log has been flushed
+        std::atomic<bool> Exit{false};                      // Flag to stop all processes
+        TSolutions Solutions;                               // Cached and in-flight solves by cube, every shard has its own lock
+        TSolveStatePtr InvalidCube;                         // Failed solve answered for strings that are no cubes
+        TClientQuota ClientQuota;                           // Solves in flight by client address
+        // Metrics, owned by TMetricsRegistry
+        TCounter *RouteRequests[R_COUNT] = {};              // Resolved once in InitMetrics, read without locks
+        TCounter *CacheHits = nullptr;
+        TCounter *CacheMisses = nullptr;
+        TCounter *CacheEvictions = nullptr;                 // Entries forgotten because the solver refused them
+        THistogram *SolveTime = nullptr;
 
         void ProcessHTTP(TSessionPtr session, THTTPRequestPtr request);
-        void MainThreadMethod();
         bool Stop();
-        bool Solve(const TUrlCgiParams &params, Json::Value &data);
-        bool LogEvent(const std::string &event, Json::Value &data);
-        void FlushLog();
+        int Solve(const TUrlCgiParams &params, const std::string &client, TJsonWriter &json);
+        bool SolveBatch(TSessionPtr session, const THTTPRequest &req);
+        void PumpBatch(const TBatchPtr &batch);
+        void FinishBatchCube(const TBatchPtr &batch, size_t index, const TSolveState *state);
+        bool LogEvent(const std::string &event, TJsonWriter &json);
+        TSolveStatePtr StartSolving(const std::string &cube, const std::string &client);
+        TSolveStatePtr StartSolving(const TCubeKey &key, const std::string &client);
+        size_t GetCostLevel(int estimate) const;
+        void InitMetrics();
 };
 
@@ -0,0 +1,104 @@
+#include "solve_state.h"
+#include "../util/base64.h"
+#include "../util/json_writer.h"
+
+
+//
+// TSolveState
+//
+
+TSolveState::TSolveState(int priority)
+    : SubmissionTime(TClock::now())
+    , Priority(priority)
+{
+}
+
+ESolveStatus TSolveState::GetStatus() const {
+    return Status.load(std::memory_order_acquire);
+}
+
+const std::vector<ETurnExt> &TSolveState::GetSolution() const {
+    return Solution;
+}
+
+const std::string &TSolveState::GetSolutionStr() const {
+    return SolutionStr;
+}
+
+const TSolveStats &TSolveState::GetStats() const {
+    return Stats;
+}
+
+TSolveState::TClock::time_point TSolveState::GetSubmissionTime() const {
+    return SubmissionTime;
+}
+
+int TSolveState::GetPriority() const {
+    return Priority;
+}
+
+size_t TSolveState::GetWaitersCount() const {
+    return WaitersCount.load(std::memory_order_relaxed);
+}
+
+void TSolveState::AddWaiter() {
+    std::unique_lock<std::mutex> lk(Mutex);
+    if (GetStatus() == SS_PENDING)
+        WaitersCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TSolveState::Subscribe(TSubscriber subscriber) {
+    {
+        std::unique_lock<std::mutex> lk(Mutex);
+        if (GetStatus() == SS_PENDING) {
+            Subscribers.push_back(std::move(subscriber));
+            return;
+        }
+    }
+    subscriber(*this);
+}
+
+void TSolveState::Finish(bool success, std::vector<ETurnExt> solution, const TSolveStats &stats) {
+    std::vector<TSubscriber> subscribers;
+    {
+        std::unique_lock<std::mutex> lk(Mutex);
+        Stats = stats;
+        if (success) {
+            SolutionStr.clear();
+            TJsonWriter json(SolutionStr);
+            json.BeginArray();
+            for (ETurnExt turn : solution)
+                json.String(TurnExt2String(turn));
+            json.EndArray();
+            Solution = std::move(solution);
+        }
+        Status.store(success ? SS_OK : SS_FAIL, std::memory_order_release);
+        WaitersCount.store(0, std::memory_order_relaxed);
+        subscribers.swap(Subscribers);
+    }
+    for (const auto &subscriber : subscribers)
+        subscriber(*this);
+}
+
+void TSolveState::Reject() {
+    std::vector<TSubscriber> subscribers;
+    {
+        std::unique_lock<std::mutex> lk(Mutex);
+        Status.store(SS_REJECTED, std::memory_order_release);
+        WaitersCount.store(0, std::memory_order_relaxed);
+        subscribers.swap(Subscribers);
+    }
+    for (const auto &subscriber : subscribers)
+        subscriber(*this);
+}
+
+
+bool ParseCubeKey(const std::string &cube, TCubeKey &key) {
+    TCube puzzle;
+    if (cube.size() == GetBase64UrlSize(sizeof(key.Data)))
+        return DecodeFromBase64Url(cube.data(), cube.size(), key.Data, sizeof(key.Data)) && puzzle.SetImage(key);
+    if (!ParsePuzzle(cube.data(), cube.size(), puzzle))
+        return false;
+    key = puzzle.GetImage();
+    return true;
+}
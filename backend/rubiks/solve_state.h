@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cube.h>
+#include <search_stats.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+
+enum ESolveStatus {
+    SS_PENDING,
+    SS_OK,
+    SS_FAIL,
+    SS_REJECTED                                             // Solver queue was full
+};
+
+
+/*
+    Shared state of one solve.
+    All requests for the same cube get the same object, so they wait for the single run of the solver.
+*/
+class TSolveState : private boost::noncopyable {
+    public:
+        using TClock = std::chrono::steady_clock;
+        using TSubscriber = std::function<void (const TSolveState &)>;
+
+        explicit TSolveState(int priority = 0);
+
+        ESolveStatus GetStatus() const;
+        const std::vector<ETurnExt> &GetSolution() const;  // Only when status is SS_OK
+        const std::string &GetSolutionStr() const;          // Solution as json array, only when status is SS_OK
+        const TSolveStats &GetStats() const;                // Search counters, only when the solve is finished
+        TClock::time_point GetSubmissionTime() const;
+        int GetPriority() const;
+        size_t GetWaitersCount() const;                     // Requests for the solve while it is pending
+
+        void AddWaiter();                                   // Counted only while pending, finishing releases all waiters
+        void Subscribe(TSubscriber subscriber);             // Called at once if the solve is already finished
+        void Finish(bool success, std::vector<ETurnExt> solution, const TSolveStats &stats = TSolveStats());
+        void Reject();
+
+    private:
+        mutable std::mutex Mutex;                           // Guards Subscribers, waiters and finishing
+        std::atomic<ESolveStatus> Status{SS_PENDING};
+        std::vector<ETurnExt> Solution;
+        std::string SolutionStr;
+        TSolveStats Stats;
+        TClock::time_point SubmissionTime;
+        int Priority = 0;
+        std::atomic<size_t> WaitersCount{0};
+        std::vector<TSubscriber> Subscribers;
+};
+
+using TSolveStatePtr = std::shared_ptr<TSolveState>;
+
+
+/*
+    Cache key of a cube: its image, the same for all spellings of the cube.
+    Cubes are given by 48 colors, spaces and case ignored, or in the compact form,
+    the 18 bytes of the image as 24 characters of base64url.
+*/
+using TCubeKey = TCubeImage<(TCube::NUM_FIELDS * TCube::BITS_FOR_COLORS + 7) / 8>;
+
+struct TCubeKeyHash {
+    size_t operator()(const TCubeKey &key) const {
+        return GetImageHash(key);
+    }
+};
+
+bool ParseCubeKey(const std::string &cube, TCubeKey &key);         // False if the string is no cube
@@ -21,3 +21,59 @@ std::string EncodeToBase64(const std::string &val) {
     return tmp.append((3 - val.size() % 3) % 3, '=');
 }
 
+
+static const char BASE64_URL_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static int DecodeBase64UrlChar(char ch) {
+    if (ch >= 'A' && ch <= 'Z')
+        return ch - 'A';
+    if (ch >= 'a' && ch <= 'z')
+        return ch - 'a' + 26;
+    if (ch >= '0' && ch <= '9')
+        return ch - '0' + 52;
+    if (ch == '-')
+        return 62;
+    if (ch == '_')
+        return 63;
+    return -1;
+}
+
+size_t GetBase64UrlSize(size_t size) {
+    return (size * 4 + 2) / 3;
+}
+
+void EncodeToBase64Url(const unsigned char *data, size_t size, char *result) {
+    unsigned bits = 0;
+    size_t bitsCount = 0;
+    for (size_t i = 0; i < size; ++i) {
+        bits = (bits << 8) | data[i];
+        bitsCount += 8;
+        while (bitsCount >= 6) {
+            bitsCount -= 6;
+            *result++ = BASE64_URL_ALPHABET[(bits >> bitsCount) & 63];
+        }
+    }
+    if (bitsCount > 0)
+        *result++ = BASE64_URL_ALPHABET[(bits << (6 - bitsCount)) & 63];
+}
+
+bool DecodeFromBase64Url(const char *data, size_t size, unsigned char *result, size_t resultSize) {
+    if (size != GetBase64UrlSize(resultSize))
+        return false;
+    unsigned bits = 0;
+    size_t bitsCount = 0;
+    size_t written = 0;
+    for (size_t i = 0; i < size; ++i) {
+        int value = DecodeBase64UrlChar(data[i]);
+        if (value < 0)
+            return false;
+        bits = (bits << 6) | value;
+        bitsCount += 6;
+        if (bitsCount >= 8) {
+            bitsCount -= 8;
+            result[written++] = static_cast<unsigned char>(bits >> bitsCount);
+        }
+    }
+    // Bits left after the last byte must be zero, so every key has one spelling
+    return (bits & ((1u << bitsCount) - 1)) == 0;
+}
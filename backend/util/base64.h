@@ -1,7 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 std::string DecodeFromBase64(const std::string &val);
 std::string EncodeToBase64(const std::string &val);
 
+// base64url without padding for short binary keys, nothing is allocated
+size_t GetBase64UrlSize(size_t size);
+void EncodeToBase64Url(const unsigned char *data, size_t size, char *result);          // GetBase64UrlSize(size) chars
+bool DecodeFromBase64Url(const char *data, size_t size, unsigned char *result, size_t resultSize);  // False unless data is exactly resultSize bytes
+
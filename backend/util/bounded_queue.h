@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+
+/*
+    Lock-free bounded queue for many producers (D. Vyukov's algorithm).
+    Capacity is rounded up to the power of two, Push fails instead of waiting when the queue is full.
+*/
+template<typename T>
+class TBoundedQueue : private boost::noncopyable {
+    public:
+        explicit TBoundedQueue(size_t capacity)
+            : Cells(RoundUp(capacity))
+            , Mask(Cells.size() - 1)
+        {
+            for (size_t i = 0; i < Cells.size(); ++i)
+                Cells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+
+        bool Push(T &&value) {
+            size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+            for (; ;) {
+                TCell &cell = Cells[pos & Mask];
+                size_t seq = cell.Sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.Value = std::move(value);
+                        cell.Sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = EnqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool Pop(T &value) {
+            size_t pos = DequeuePos.load(std::memory_order_relaxed);
+            for (; ;) {
+                TCell &cell = Cells[pos & Mask];
+                size_t seq = cell.Sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        value = std::move(cell.Value);
+                        cell.Sequence.store(pos + Mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = DequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Approximate number of queued elements
+        size_t Size() const {
+            size_t enqueued = EnqueuePos.load(std::memory_order_relaxed);
+            size_t dequeued = DequeuePos.load(std::memory_order_relaxed);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        size_t Capacity() const {
+            return Cells.size();
+        }
+
+    private:
+        struct TCell {
+            std::atomic<size_t> Sequence;
+            T Value;
+        };
+
+        std::vector<TCell> Cells;
+        size_t Mask = 0;
+        std::atomic<size_t> EnqueuePos{0};
+        std::atomic<size_t> DequeuePos{0};
+
+        static size_t RoundUp(size_t capacity) {
+            size_t result = 2;
+            while (result < capacity)
+                result *= 2;
+            return result;
+        }
+};
@@ -0,0 +1,133 @@
+#include "json_writer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+
+//
+// TJsonWriter
+//
+
+TJsonWriter::TJsonWriter(std::string &out)
+    : Out(out)
+{
+}
+
+void TJsonWriter::BeforeValue() {
+    if (AfterKey) {
+        AfterKey = false;
+        return;
+    }
+    if (Depth == 0)
+        return;
+    uint64_t bit = static_cast<uint64_t>(1) << (Depth - 1);
+    if (HasItems & bit)
+        Out += ',';
+    HasItems |= bit;
+}
+
+void TJsonWriter::Open(char ch) {
+    BeforeValue();
+    if (Depth == MAX_DEPTH)
+        throw std::logic_error("Json is nested too deep.");
+    Out += ch;
+    ++Depth;
+    HasItems &= ~(static_cast<uint64_t>(1) << (Depth - 1));
+}
+
+void TJsonWriter::Close(char ch) {
+    if (Depth == 0)
+        throw std::logic_error("Nothing to close in json.");
+    --Depth;
+    Out += ch;
+}
+
+TJsonWriter &TJsonWriter::BeginObject() {
+    Open('{');
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::EndObject() {
+    Close('}');
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::BeginArray() {
+    Open('[');
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::EndArray() {
+    Close(']');
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::Key(const char *key) {
+    BeforeValue();
+    Out += '"';
+    Out += key;
+    Out += "\":";
+    AfterKey = true;
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::String(const char *value, size_t size) {
+    static const char HEX[] = "0123456789abcdef";
+    BeforeValue();
+    Out += '"';
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char ch = static_cast<unsigned char>(value[i]);
+        if (ch == '"' || ch == '\\') {
+            Out += '\\';
+            Out += static_cast<char>(ch);
+        } else if (ch < 0x20) {
+            char escaped[] = { '\\', 'u', '0', '0', HEX[ch >> 4], HEX[ch & 15] };
+            Out.append(escaped, sizeof(escaped));
+        } else {
+            Out += static_cast<char>(ch);
+        }
+    }
+    Out += '"';
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::String(const std::string &value) {
+    return String(value.data(), value.size());
+}
+
+TJsonWriter &TJsonWriter::String(const char *value) {
+    return String(value, std::strlen(value));
+}
+
+TJsonWriter &TJsonWriter::Number(uint64_t value) {
+    BeforeValue();
+    char buffer[24];
+    size_t size = 0;
+    do {
+        buffer[size++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (size > 0)
+        Out += buffer[--size];
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::Number(double value) {
+    BeforeValue();
+    // Json has no nan or infinity, jsoncpp writes null for them as well
+    if (!std::isfinite(value)) {
+        Out += "null";
+        return *this;
+    }
+    char buffer[32];
+    int size = snprintf(buffer, sizeof(buffer), "%.17g", value);
+    Out.append(buffer, size > 0 ? size : 0);
+    return *this;
+}
+
+TJsonWriter &TJsonWriter::Raw(const std::string &json) {
+    BeforeValue();
+    Out += json;
+    return *this;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <boost/noncopyable.hpp>
+
+
+/*
+    Writer of json straight into the output string, for the responses made on every request.
+    Nothing is allocated besides the growth of the output, commas are placed by the writer.
+    Nesting is limited to MAX_DEPTH levels.
+*/
+class TJsonWriter : private boost::noncopyable {
+    public:
+        static constexpr size_t MAX_DEPTH = 64;
+
+        explicit TJsonWriter(std::string &out);
+
+        TJsonWriter &BeginObject();
+        TJsonWriter &EndObject();
+        TJsonWriter &BeginArray();
+        TJsonWriter &EndArray();
+        TJsonWriter &Key(const char *key);                  // Keys are written as is, they are literals of the code
+        TJsonWriter &String(const char *value, size_t size);
+        TJsonWriter &String(const std::string &value);
+        TJsonWriter &String(const char *value);
+        TJsonWriter &Number(uint64_t value);
+        TJsonWriter &Number(double value);                  // null for nan and infinity
+        TJsonWriter &Raw(const std::string &json);          // Value rendered before, e.g. a cached solution
+
+    private:
+        std::string &Out;
+        size_t Depth = 0;
+        uint64_t HasItems = 0;                              // Bit per level, set after its first item
+        bool AfterKey = false;
+
+        void BeforeValue();
+        void Open(char ch);
+        void Close(char ch);
+};
@@ -0,0 +1,182 @@
+#include "log_writer.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <logger.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+//
+// TLogWriter
+//
+
+TLogWriter::TLogWriter(const TOptions &options)
+    : Options(options)
+    , Queue(options.QueueSize)
+{
+    Batch.reserve(MAX_BATCH_SIZE);
+    Iov.reserve(MAX_BATCH_SIZE * 2);
+}
+
+TLogWriter::~TLogWriter() {
+    CloseFile();
+}
+
+bool TLogWriter::Write(std::string record) {
+    if (Queue.Push(std::move(record)))
+        return true;
+    DroppedCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void TLogWriter::Run() {
+    LastFlushingTime = time(nullptr);
+    WritingThread = std::thread([this]() { WritingThreadMethod(); });
+}
+
+void TLogWriter::Stop() {
+    std::unique_lock<std::mutex> lk(Mutex);
+    Exit = true;
+    Condition.notify_all();
+}
+
+void TLogWriter::Join() {
+    Stop();
+    if (WritingThread.joinable())
+        WritingThread.join();
+    LOGGER_INFO("Log writer: " << GetWrittenCount() << " written, " << GetDroppedCount() << " dropped, "
+                << GetFailedCount() << " failed, " << GetRotationsCount() << " rotations");
+}
+
+size_t TLogWriter::GetWrittenCount() const {
+    return WrittenCount.load(std::memory_order_relaxed);
+}
+
+size_t TLogWriter::GetDroppedCount() const {
+    return DroppedCount.load(std::memory_order_relaxed);
+}
+
+size_t TLogWriter::GetFailedCount() const {
+    return FailedCount.load(std::memory_order_relaxed);
+}
+
+size_t TLogWriter::GetRotationsCount() const {
+    return RotationsCount.load(std::memory_order_relaxed);
+}
+
+void TLogWriter::WritingThreadMethod() {
+    for (; ;) {
+        bool exit = Exit;
+        if (exit || Queue.Size() >= Options.FillingThreshold || LastFlushingTime + static_cast<time_t>(Options.FlushInterval) < time(nullptr))
+            Flush();
+        if (exit)
+            break;
+        std::unique_lock<std::mutex> lk(Mutex);
+        if (!Exit)
+            Condition.wait_for(lk, std::chrono::milliseconds(100));
+    }
+    CloseFile();
+}
+
+void TLogWriter::Flush() {
+    LastFlushingTime = time(nullptr);
+    std::string record;
+    while (Queue.Pop(record)) {
+        Batch.push_back(std::move(record));
+        if (Batch.size() >= MAX_BATCH_SIZE)
+            WriteBatch();
+    }
+    WriteBatch();
+}
+
+void TLogWriter::WriteBatch() {
+    if (Batch.empty())
+        return;
+    RotateIfNeeded();
+    if (Fd == -1 && !OpenFile()) {
+        FailedCount.fetch_add(Batch.size(), std::memory_order_relaxed);
+        Batch.clear();
+        return;
+    }
+    static const char NewLine = '\n';
+    size_t total = 0;
+    Iov.clear();
+    for (const auto &record : Batch) {
+        Iov.push_back({const_cast<char*>(record.data()), record.size()});
+        Iov.push_back({const_cast<char*>(&NewLine), 1});
+        total += record.size() + 1;
+    }
+    // Short writes are possible, so continue from the first not completely written buffer
+    size_t written = 0, first = 0;
+    char lastByte = NewLine;
+    while (written < total) {
+        ssize_t res = writev(Fd, Iov.data() + first, static_cast<int>(Iov.size() - first));
+        if (res <= 0) {
+            if (res < 0 && errno == EINTR)
+                continue;
+            LOGGER_ERROR("TLogWriter::WriteBatch, writev failed: " << (res < 0 ? strerror(errno) : "nothing written"));
+            break;
+        }
+        written += res;
+        for (size_t left = res; left > 0; ) {
+            char *base = static_cast<char*>(Iov[first].iov_base);
+            if (left >= Iov[first].iov_len) {
+                left -= Iov[first].iov_len;
+                if (Iov[first].iov_len != 0)
+                    lastByte = base[Iov[first].iov_len - 1];
+                ++first;
+            } else {
+                lastByte = base[left - 1];
+                Iov[first].iov_base = base + left;
+                Iov[first].iov_len -= left;
+                left = 0;
+            }
+        }
+    }
+    // A record cut by the failure is ended, so the next batch starts on its own line
+    if (lastByte != NewLine && write(Fd, &NewLine, 1) == 1)
+        ++written;
+    FileSize += written;
+    if (written == total)
+        WrittenCount.fetch_add(Batch.size(), std::memory_order_relaxed);
+    else
+        FailedCount.fetch_add(Batch.size(), std::memory_order_relaxed);
+    Batch.clear();
+}
+
+bool TLogWriter::OpenFile() {
+    Fd = open(Options.Path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (Fd == -1) {
+        LOGGER_ERROR("TLogWriter::OpenFile, can't open " << Options.Path << ": " << strerror(errno));
+        return false;
+    }
+    struct stat st;
+    FileSize = fstat(Fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    FileOpeningTime = time(nullptr);
+    return true;
+}
+
+void TLogWriter::CloseFile() {
+    if (Fd == -1)
+        return;
+    close(Fd);
+    Fd = -1;
+}
+
+void TLogWriter::RotateIfNeeded() {
+    if (Fd == -1)
+        return;
+    bool bySize = Options.RotationSize != 0 && FileSize >= Options.RotationSize;
+    bool byAge = Options.RotationInterval != 0 && FileSize != 0 &&
+                 FileOpeningTime + static_cast<time_t>(Options.RotationInterval) <= time(nullptr);
+    if (!bySize && !byAge)
+        return;
+    CloseFile();
+    std::string rotated = Options.Path + "." + std::to_string(time(nullptr)) + "." + std::to_string(RotationsCount.fetch_add(1));
+    if (rename(Options.Path.c_str(), rotated.c_str()) != 0)
+        LOGGER_ERROR("TLogWriter::RotateIfNeeded, can't rename " << Options.Path << ": " << strerror(errno));
+}
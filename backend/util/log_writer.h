@@ -0,0 +1,75 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <limits.h>
+#include <sys/uio.h>
+
+
+/*
+    Appends records to the log file on its own thread.
+    Write never blocks: records go to the lock-free queue and are dropped when it is full.
+    The file is kept open and written in batches with writev, it is rotated by size and by age.
+*/
+class TLogWriter : private boost::noncopyable {
+    public:
+        struct TOptions {
+            std::string Path;
+            size_t QueueSize = 65536;
+            size_t FlushInterval = 10;                      // Seconds between flushes
+            size_t FillingThreshold = 100;                  // Number of records after which flushing is needed anyway
+            size_t RotationSize = 0;                        // Rotate after the file exceeds this number of bytes, 0 means never
+            size_t RotationInterval = 0;                    // Rotate after the file is this many seconds old, 0 means never
+        };
+
+        explicit TLogWriter(const TOptions &options);
+        ~TLogWriter();
+
+        bool Write(std::string record);                     // false if the record was dropped
+        void Run();
+        void Stop();
+        void Join();                                        // Stops and writes everything left in the queue
+
+        size_t GetWrittenCount() const;
+        size_t GetDroppedCount() const;
+        size_t GetFailedCount() const;
+        size_t GetRotationsCount() const;
+
+    private:
+        static constexpr size_t MAX_BATCH_SIZE = IOV_MAX / 2;  // Every record takes two buffers: itself and the line end
+
+        TOptions Options;
+        TBoundedQueue<std::string> Queue;
+        std::thread WritingThread;
+        std::mutex Mutex;                                   // Only for sleeping on Condition
+        std::condition_variable Condition;
+        std::atomic<bool> Exit{false};
+        int Fd = -1;
+        size_t FileSize = 0;
+        time_t FileOpeningTime = 0;
+        time_t LastFlushingTime = 0;
+        std::vector<std::string> Batch;
+        std::vector<iovec> Iov;
+        std::atomic<size_t> WrittenCount{0};                // Records written to the file
+        std::atomic<size_t> DroppedCount{0};                // Records rejected because the queue was full
+        std::atomic<size_t> FailedCount{0};                 // Records lost because of write errors
+        std::atomic<size_t> RotationsCount{0};
+
+    private:
+        void WritingThreadMethod();
+        void Flush();
+        void WriteBatch();
+        bool OpenFile();
+        void CloseFile();
+        void RotateIfNeeded();
+};
+
+using TLogWriterPtr = std::shared_ptr<TLogWriter>;
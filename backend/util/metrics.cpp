@@ -0,0 +1,195 @@
+#include "metrics.h"
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+
+
+size_t GetMetricsCell() {
+    static std::atomic<size_t> nextCell{0};
+    static thread_local size_t cell = nextCell.fetch_add(1, std::memory_order_relaxed) % METRICS_CELLS_COUNT;
+    return cell;
+}
+
+void *AllocateMetricsCells(size_t size) {
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, METRICS_CELL_ALIGNMENT, size ? size : 1) != 0)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void FreeMetricsCells(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+
+//
+// TCounter
+//
+
+uint64_t TCounter::Get() const {
+    uint64_t result = 0;
+    for (const TCell &cell : Cells)
+        result += cell.Value.load(std::memory_order_relaxed);
+    return result;
+}
+
+
+//
+// THistogram
+//
+
+THistogram::THistogram()
+    : Cells(new TCell[METRICS_CELLS_COUNT])
+{
+    for (size_t i = 0; i < METRICS_CELLS_COUNT; ++i) {
+        for (auto &count : Cells[i].Counts)
+            count.store(0, std::memory_order_relaxed);
+    }
+}
+
+THistogram::~THistogram() {
+}
+
+size_t THistogram::GetBucket(uint64_t micros) {
+    if (micros < SUB_BUCKETS_COUNT)
+        return micros;
+    size_t exponent = 63 - __builtin_clzll(micros);
+    if (exponent > MAX_EXPONENT)
+        return BUCKETS_COUNT - 1;
+    size_t sub = (micros >> (exponent - SUB_BUCKETS_BITS)) & (SUB_BUCKETS_COUNT - 1);
+    return (exponent - SUB_BUCKETS_BITS + 1) * SUB_BUCKETS_COUNT + sub;
+}
+
+uint64_t THistogram::GetBucketLowerBound(size_t bucket) {
+    if (bucket < SUB_BUCKETS_COUNT)
+        return bucket;
+    size_t exponent = bucket / SUB_BUCKETS_COUNT + SUB_BUCKETS_BITS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS_COUNT;
+    return (SUB_BUCKETS_COUNT + sub) << (exponent - SUB_BUCKETS_BITS);
+}
+
+void THistogram::Observe(double seconds) {
+    uint64_t micros = seconds > 0 ? static_cast<uint64_t>(seconds * 1e6) : 0;
+    TCell &cell = Cells[GetMetricsCell()];
+    cell.Counts[GetBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    cell.SumMicros.fetch_add(micros, std::memory_order_relaxed);
+}
+
+THistogram::TSnapshot THistogram::GetSnapshot() const {
+    TSnapshot result;
+    result.Counts.assign(BUCKETS_COUNT, 0);
+    uint64_t sumMicros = 0;
+    for (size_t i = 0; i < METRICS_CELLS_COUNT; ++i) {
+        for (size_t j = 0; j < BUCKETS_COUNT; ++j) {
+            uint64_t count = Cells[i].Counts[j].load(std::memory_order_relaxed);
+            result.Counts[j] += count;
+            result.Count += count;
+        }
+        sumMicros += Cells[i].SumMicros.load(std::memory_order_relaxed);
+    }
+    result.Sum = sumMicros / 1e6;
+    return result;
+}
+
+
+//
+// TMetricsRegistry
+//
+
+TMetricsRegistry &TMetricsRegistry::Instance() {
+    static TMetricsRegistry registry;
+    return registry;
+}
+
+TMetricsRegistry::TSeries &TMetricsRegistry::GetSeries(const std::string &name, const std::string &help,
+                                                       const std::string &type, const std::string &labels) {
+    TFamily &family = Families[name];
+    if (family.Type.empty()) {
+        family.Help = help;
+        family.Type = type;
+    } else if (family.Type != type) {
+        throw std::logic_error("Metric " + name + " is already registered as " + family.Type);
+    }
+    return family.Series[labels];
+}
+
+TCounter &TMetricsRegistry::GetCounter(const std::string &name, const std::string &help, const std::string &labels) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    TSeries &series = GetSeries(name, help, "counter", labels);
+    if (!series.Counter)
+        series.Counter.reset(new TCounter);
+    return *series.Counter;
+}
+
+TGauge &TMetricsRegistry::GetGauge(const std::string &name, const std::string &help, const std::string &labels) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    TSeries &series = GetSeries(name, help, "gauge", labels);
+    if (!series.Gauge)
+        series.Gauge.reset(new TGauge);
+    return *series.Gauge;
+}
+
+THistogram &TMetricsRegistry::GetHistogram(const std::string &name, const std::string &help, const std::string &labels) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    TSeries &series = GetSeries(name, help, "histogram", labels);
+    if (!series.Histogram)
+        series.Histogram.reset(new THistogram);
+    return *series.Histogram;
+}
+
+void TMetricsRegistry::AddCallback(const std::string &name, const std::string &help, bool isCounter, TCallback callback,
+                                   const std::string &labels) {
+    std::unique_lock<std::mutex> lk(Mutex);
+    GetSeries(name, help, isCounter ? "counter" : "gauge", labels).Callback = std::move(callback);
+}
+
+static std::string JoinLabels(const std::string &labels, const std::string &extra) {
+    if (labels.empty() && extra.empty())
+        return std::string();
+    if (labels.empty() || extra.empty())
+        return "{" + labels + extra + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+std::string TMetricsRegistry::Render() const {
+    std::ostringstream out;
+    out.precision(9);
+    std::unique_lock<std::mutex> lk(Mutex);
+    for (const auto &family : Families) {
+        const std::string &name = family.first;
+        out << "# HELP " << name << " " << family.second.Help << "\n";
+        out << "# TYPE " << name << " " << family.second.Type << "\n";
+        for (const auto &it : family.second.Series) {
+            const std::string &labels = it.first;
+            const TSeries &series = it.second;
+            if (series.Counter) {
+                out << name << JoinLabels(labels, "") << " " << series.Counter->Get() << "\n";
+            } else if (series.Gauge) {
+                out << name << JoinLabels(labels, "") << " " << series.Gauge->Get() << "\n";
+            } else if (series.Callback) {
+                out << name << JoinLabels(labels, "") << " " << series.Callback() << "\n";
+            } else if (series.Histogram) {
+                // Cumulative counts at every power of two up to the last non-empty bucket
+                THistogram::TSnapshot snapshot = series.Histogram->GetSnapshot();
+                size_t last = 0;
+                for (size_t i = 0; i < snapshot.Counts.size(); ++i) {
+                    if (snapshot.Counts[i] != 0)
+                        last = i;
+                }
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i <= last; ++i) {
+                    cumulative += snapshot.Counts[i];
+                    uint64_t upper = THistogram::GetBucketLowerBound(i + 1);
+                    if ((upper & (upper - 1)) == 0 || i == last)
+                        out << name << "_bucket" << JoinLabels(labels, "le=\"" + std::to_string(upper / 1e6) + "\"") << " " << cumulative << "\n";
+                }
+                out << name << "_bucket" << JoinLabels(labels, "le=\"+Inf\"") << " " << snapshot.Count << "\n";
+                out << name << "_sum" << JoinLabels(labels, "") << " " << snapshot.Sum << "\n";
+                out << name << "_count" << JoinLabels(labels, "") << " " << snapshot.Count << "\n";
+            }
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+
+/*
+    Metrics for the /metrics endpoint in the Prometheus text format.
+    Counters and histograms are split into cells, every thread updates its own cell with relaxed atomics,
+    so updates never lock and rarely share a cache line. Cells are summed only when metrics are rendered.
+*/
+
+static constexpr size_t METRICS_CELLS_COUNT = 16;
+
+size_t GetMetricsCell();                                    // Cell of the current thread
+
+// Plain new does not honor alignas(64) before C++17, so cells are allocated with these
+static constexpr size_t METRICS_CELL_ALIGNMENT = 64;
+
+void *AllocateMetricsCells(size_t size);
+void FreeMetricsCells(void *ptr) noexcept;
+
+
+class TCounter : private boost::noncopyable {
+    public:
+        void Add(uint64_t value = 1) {
+            Cells[GetMetricsCell()].Value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        uint64_t Get() const;
+
+        static void *operator new(size_t size) {
+            return AllocateMetricsCells(size);
+        }
+
+        static void operator delete(void *ptr) noexcept {
+            FreeMetricsCells(ptr);
+        }
+
+    private:
+        struct alignas(METRICS_CELL_ALIGNMENT) TCell {
+            std::atomic<uint64_t> Value{0};
+        };
+
+        TCell Cells[METRICS_CELLS_COUNT];
+};
+
+
+class TGauge : private boost::noncopyable {
+    public:
+        void Add(int64_t value) {
+            Value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        void Set(int64_t value) {
+            Value.store(value, std::memory_order_relaxed);
+        }
+
+        int64_t Get() const {
+            return Value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<int64_t> Value{0};
+};
+
+
+/*
+    Histogram of durations with log-linear buckets as in HdrHistogram:
+    every power of two of microseconds is split into 8 equal buckets, so the relative error is below 12.5%.
+    Exported with bucket bounds at powers of two of microseconds.
+*/
+class THistogram : private boost::noncopyable {
+    public:
+        static constexpr size_t SUB_BUCKETS_BITS = 3;
+        static constexpr size_t SUB_BUCKETS_COUNT = 1 << SUB_BUCKETS_BITS;
+        static constexpr size_t MAX_EXPONENT = 40;          // About 12 days in microseconds
+        static constexpr size_t BUCKETS_COUNT = (MAX_EXPONENT - SUB_BUCKETS_BITS + 2) * SUB_BUCKETS_COUNT;
+
+        struct TSnapshot {
+            std::vector<uint64_t> Counts;                   // By bucket
+            uint64_t Count = 0;
+            double Sum = 0;                                 // Seconds
+        };
+
+        THistogram();
+        ~THistogram();
+
+        void Observe(double seconds);
+        TSnapshot GetSnapshot() const;
+
+        static size_t GetBucket(uint64_t micros);
+        static uint64_t GetBucketLowerBound(size_t bucket);  // Microseconds
+
+    private:
+        struct alignas(METRICS_CELL_ALIGNMENT) TCell {
+            std::atomic<uint64_t> Counts[BUCKETS_COUNT];
+            std::atomic<uint64_t> SumMicros{0};
+
+            static void *operator new[](size_t size) {
+                return AllocateMetricsCells(size);
+            }
+
+            static void operator delete[](void *ptr) noexcept {
+                FreeMetricsCells(ptr);
+            }
+        };
+
+        std::unique_ptr<TCell[]> Cells;
+};
+
+
+/*
+    Named metrics. Families are registered at startup and live as long as the registry,
+    so the returned references can be kept by their users.
+*/
+class TMetricsRegistry : private boost::noncopyable {
+    public:
+        using TCallback = std::function<double()>;
+
+        static TMetricsRegistry &Instance();
+
+        // labels are written as is, e.g. route="solve"
+        TCounter &GetCounter(const std::string &name, const std::string &help, const std::string &labels = std::string());
+        TGauge &GetGauge(const std::string &name, const std::string &help, const std::string &labels = std::string());
+        THistogram &GetHistogram(const std::string &name, const std::string &help, const std::string &labels = std::string());
+        // Values owned by somebody else, read on rendering
+        void AddCallback(const std::string &name, const std::string &help, bool isCounter, TCallback callback,
+                         const std::string &labels = std::string());
+
+        std::string Render() const;
+
+    private:
+        struct TSeries {
+            std::unique_ptr<TCounter> Counter;
+            std::unique_ptr<TGauge> Gauge;
+            std::unique_ptr<THistogram> Histogram;
+            TCallback Callback;
+        };
+
+        struct TFamily {
+            std::string Help;
+            std::string Type;
+            std::map<std::string, TSeries> Series;          // By labels
+        };
+
+        mutable std::mutex Mutex;                           // Guards registration and rendering, not updates
+        std::map<std::string, TFamily> Families;
+
+        TMetricsRegistry() = default;
+        ~TMetricsRegistry() = default;
+
+        TSeries &GetSeries(const std::string &name, const std::string &help, const std::string &type, const std::string &labels);
+};
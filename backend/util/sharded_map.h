@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+
+/*
+    Hash map split into independently locked shards.
+    Operations on keys from different shards never wait for each other.
+*/
+template<typename TKey, typename TValue, typename THash = std::hash<TKey>>
+class TShardedMap : private boost::noncopyable {
+    public:
+        explicit TShardedMap(size_t shardCount = 64)
+            : Shards(shardCount > 0 ? shardCount : 1)
+        {
+        }
+
+        // Inserts value if key is absent, current gets the value stored under the key; true if inserted
+        bool Emplace(const TKey &key, const TValue &value, TValue &current) {
+            TShard &shard = GetShard(key);
+            std::unique_lock<std::mutex> lk(shard.Mutex);
+            auto res = shard.Items.emplace(key, value);
+            current = res.first->second;
+            return res.second;
+        }
+
+        bool Get(const TKey &key, TValue &value) const {
+            const TShard &shard = GetShard(key);
+            std::unique_lock<std::mutex> lk(shard.Mutex);
+            auto it = shard.Items.find(key);
+            if (it == shard.Items.end())
+                return false;
+            value = it->second;
+            return true;
+        }
+
+        void Set(const TKey &key, TValue value) {
+            TShard &shard = GetShard(key);
+            std::unique_lock<std::mutex> lk(shard.Mutex);
+            shard.Items[key] = std::move(value);
+        }
+
+        bool Erase(const TKey &key) {
+            TShard &shard = GetShard(key);
+            std::unique_lock<std::mutex> lk(shard.Mutex);
+            return shard.Items.erase(key) != 0;
+        }
+
+        // Values for which the predicate holds, collected shard by shard under its lock
+        std::vector<TValue> Select(const std::function<bool (const TValue &)> &predicate) const {
+            std::vector<TValue> result;
+            for (const auto &shard : Shards) {
+                std::unique_lock<std::mutex> lk(shard.Mutex);
+                for (const auto &item : shard.Items) {
+                    if (predicate(item.second))
+                        result.push_back(item.second);
+                }
+            }
+            return result;
+        }
+
+        size_t Size() const {
+            size_t result = 0;
+            for (const auto &shard : Shards) {
+                std::unique_lock<std::mutex> lk(shard.Mutex);
+                result += shard.Items.size();
+            }
+            return result;
+        }
+
+    private:
+        struct TShard {
+            mutable std::mutex Mutex;
+            std::unordered_map<TKey, TValue, THash> Items;
+        };
+
+        std::vector<TShard> Shards;
+        THash Hash;
+
+        TShard &GetShard(const TKey &key) {
+            return Shards[Hash(key) % Shards.size()];
+        }
+
+        const TShard &GetShard(const TKey &key) const {
+            return Shards[Hash(key) % Shards.size()];
+        }
+};
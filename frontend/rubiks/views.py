@@ -6,7 +6,7 @@ from django.template.loader import get_template
 from django.utils.six.moves.urllib.parse import parse_qsl, urlparse, urlunparse
 from django.utils.cache import patch_cache_control
 from django.views.decorators.csrf import csrf_exempt
-import urllib.request, time, base64, json
+import urllib.request, urllib.error, time, base64, json
 
 
 def do_general(request, body):
@@ -29,25 +29,36 @@ def main_page(request):
     return do_general(request, 'main.html')
 
 
-def Solve(cube):
+def Solve(cube, client):
+    """Returns the answer of the backend and the Retry-After it gave, None for the answer on errors."""
     try:
         if not cube:
-            return None
+            return None, None
         request = urllib.request.Request("http://localhost:17071/solve?cube={}".format(cube), method='GET')
+        if client:
+            request.add_header("X-Forwarded-For", client)
         response = urllib.request.urlopen(request)
         if response.status != 200:
-            return None
-        return response.read()
+            return None, None
+        return response.read(), None
+    except urllib.error.HTTPError as e:
+        # Solver is overloaded, pass {"state": "busy"} and the delay to wait to the client
+        if e.code in (429, 503):
+            return e.read(), e.headers.get("Retry-After")
+        return None, None
     except Exception as e:
-        return None
+        return None, None
 
 
 def solve_page(request):
     cube = request.GET.get("cube", "")
-    answer = Solve(cube)
+    answer, retry_after = Solve(cube, request.META.get("REMOTE_ADDR", ""))
     if not answer:
         answer = """{"state": "fail", "message": "could not reach backend or bad parameters"}"""
-    return HttpResponse(answer, content_type="text/json")
+    response = HttpResponse(answer, content_type="text/json")
+    if retry_after:
+        response["Retry-After"] = retry_after
+    return response
 
 
 def Log(data):
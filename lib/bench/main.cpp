@@ -0,0 +1,275 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "../cube.h"
+#include "../kociemba_impl.h"
+
+
+// Every allocation is counted to report allocs/op next to ns/op.
+// All the forms of new and delete are replaced, so every pointer is released by the allocator that made it.
+// They are kept out of line, otherwise the compiler sees free() on the result of new and warns about a mismatch.
+static std::atomic<size_t> AllocationsCount(0);
+
+__attribute__((noinline)) static void *CountedAllocate(size_t size) noexcept {
+    AllocationsCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) static void CountedFree(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void *operator new(size_t size) {
+    if (void *ptr = CountedAllocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    if (void *ptr = CountedAllocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return CountedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return CountedAllocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    CountedFree(ptr);
+}
+
+
+class TAllocationsCounter {
+    public:
+        explicit TAllocationsCounter(benchmark::State &state)
+            : State(state)
+            , Start(AllocationsCount.load(std::memory_order_relaxed))
+        {
+        }
+
+        ~TAllocationsCounter() {
+            double allocs = static_cast<double>(AllocationsCount.load(std::memory_order_relaxed) - Start);
+            State.counters["allocs/op"] = benchmark::Counter(allocs, benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        benchmark::State &State;
+        size_t Start;
+};
+
+
+static const char *SCRAMBLED = "ooyorwyb gobbwyyg rrrboobb rywgwwby bgywywro owgrgggr";
+
+static TCube MakeScrambled() {
+    return MakePuzzle(SCRAMBLED);
+}
+
+static const std::vector<ETurnExt> &GetSequence() {
+    static const std::vector<ETurnExt> Sequence = { TE_D2, TE_F1, TE_R1, TE_F2, TE_U1, TE_R1, TE_B, TE_F, TE_U2, TE_L1,
+                                                    TE_D, TE_L2, TE_U1, TE_L2, TE_F2, TE_L2, TE_F2, TE_U1, TE_L2 };
+    return Sequence;
+}
+
+
+static void BM_CubeGetColor(benchmark::State &state) {
+    TCube cube = MakeScrambled();
+    TAllocationsCounter allocs(state);
+    for (auto _ : state) {
+        for (size_t i = 0; i < TCube::NUM_FIELDS; ++i)
+            benchmark::DoNotOptimize(cube.GetColor(i));
+    }
+    state.SetItemsProcessed(state.iterations() * TCube::NUM_FIELDS);
+}
+BENCHMARK(BM_CubeGetColor);
+
+static void BM_CubeSetColor(benchmark::State &state) {
+    TCube cube = MakeScrambled();
+    TAllocationsCounter allocs(state);
+    for (auto _ : state) {
+        for (size_t i = 0; i < TCube::NUM_FIELDS; ++i)
+            cube.SetColor(i, static_cast<EColor>(i % 6));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * TCube::NUM_FIELDS);
+}
+BENCHMARK(BM_CubeSetColor);
+
+static void BM_MoveAct(benchmark::State &state) {
+    TCube cube = MakeScrambled();
+    const TMove &move = TurnExt2Move(TE_R);
+    TAllocationsCounter allocs(state);
+    for (auto _ : state) {
+        cube = move.Act(cube);
+        benchmark::DoNotOptimize(cube);
+    }
+}
+BENCHMARK(BM_MoveAct);
+
+static void BM_MoveMultiply(benchmark::State &state) {
+    TMove base;
+    for (ETurnExt turn : GetSequence())
+        base *= TurnExt2Move(turn);
+    const TMove &move = TurnExt2Move(TE_F);
+    TAllocationsCounter allocs(state);
+    for (auto _ : state) {
+        TMove m(base);
+        m *= move;
+        benchmark::DoNotOptimize(m);
+    }
+}
+BENCHMARK(BM_MoveMultiply);
+
+static void BM_MoveDivide(benchmark::State &state) {
+    TMove base, tail;
+    for (ETurnExt turn : GetSequence()) {
+        base *= TurnExt2Move(turn);
+        if (tail.GetTotalTurnsCount() < 6)
+            tail *= TurnExt2Move(turn);
+    }
+    TAllocationsCounter allocs(state);
+    for (auto _ : state) {
+        TMove m(base);
+        m /= tail;
+        benchmark::DoNotOptimize(m);
+    }
+}
+BENCHMARK(BM_MoveDivide);
+
+static void BM_Turns2Exts(benchmark::State &state) {
+    TMove move;
+    for (ETurnExt turn : GetSequence())
+        move *= TurnExt2Move(turn);
+    std::vector<ETurn> turns = move.GetTurns();
+    TAllocationsCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Turns2Exts(turns));
+}
+BENCHMARK(BM_Turns2Exts);
+
+static void BM_MakePuzzle(benchmark::State &state) {
+    std::string colors(SCRAMBLED);
+    TAllocationsCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(MakePuzzle(colors));
+}
+BENCHMARK(BM_MakePuzzle);
+
+static void BM_ParsePuzzle(benchmark::State &state) {
+    std::string colors(SCRAMBLED);
+    TCube cube;
+    TAllocationsCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(ParsePuzzle(colors.data(), colors.size(), cube));
+}
+BENCHMARK(BM_ParsePuzzle);
+
+template<size_t N>
+static void BM_HashCubeImage(benchmark::State &state) {
+    TCubeImage<N> image;
+    for (size_t i = 0; i < N; ++i)
+        image.Data[i] = static_cast<unsigned char>(i * 37 + 11);
+    std::hash<TCubeImage<N>> hash;
+    TAllocationsCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(hash(image));
+}
+BENCHMARK_TEMPLATE(BM_HashCubeImage, 2);
+BENCHMARK_TEMPLATE(BM_HashCubeImage, 5);
+BENCHMARK_TEMPLATE(BM_HashCubeImage, 9);
+
+
+// Stages build their tables and the tables of their estimators on the first use, that is done before timing starts
+// The cube is decoded once, GetIndex is the inline call of DoGetImage, so only the coordinate is timed
+template<typename TEstimator>
+static void BM_EstimatorDoGetImage(benchmark::State &state, const TEstimator &(*getEstimator)()) {
+    const TEstimator &estimator = getEstimator();
+    TCubeColors colors(MakeScrambled());
+    TAllocationsCounter allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(colors);
+        benchmark::DoNotOptimize(estimator.GetIndex(colors));
+    }
+}
+
+template<typename TEstimator>
+static void BM_EstimatorEstimate(benchmark::State &state, const TEstimator &(*getEstimator)()) {
+    const TEstimator &estimator = getEstimator();
+    TCube cube = MakeScrambled();
+    TAllocationsCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(estimator.Estimate(cube));
+}
+
+static const TG0CornersEstimator &G0Corners() { return TG0Stage::Instance().GetCornersEstimator(); }
+static const TG0EdgeEstimator &G0Edge() { return TG0Stage::Instance().GetEdgeEstimator(); }
+static const TG0MiddleLayerEdgesEstimator &G0Middle() { return TG0Stage::Instance().GetMiddleLayerEdgesEstimator(); }
+static const TG1CornersEstimator &G1Corners() { return TG1Stage::Instance().GetCornersEstimator(); }
+static const TG1EdgeEstimator &G1Edge() { return TG1Stage::Instance().GetEdgeEstimator(); }
+static const TG1MiddleLayerEdgesEstimator &G1Middle() { return TG1Stage::Instance().GetMiddleLayerEdgesEstimator(); }
+
+BENCHMARK_CAPTURE(BM_EstimatorDoGetImage, TG0CornersEstimator, &G0Corners);
+BENCHMARK_CAPTURE(BM_EstimatorEstimate, TG0CornersEstimator, &G0Corners);
+BENCHMARK_CAPTURE(BM_EstimatorDoGetImage, TG0EdgeEstimator, &G0Edge);
+BENCHMARK_CAPTURE(BM_EstimatorEstimate, TG0EdgeEstimator, &G0Edge);
+BENCHMARK_CAPTURE(BM_EstimatorDoGetImage, TG0MiddleLayerEdgesEstimator, &G0Middle);
+BENCHMARK_CAPTURE(BM_EstimatorEstimate, TG0MiddleLayerEdgesEstimator, &G0Middle);
+BENCHMARK_CAPTURE(BM_EstimatorDoGetImage, TG1CornersEstimator, &G1Corners);
+BENCHMARK_CAPTURE(BM_EstimatorEstimate, TG1CornersEstimator, &G1Corners);
+BENCHMARK_CAPTURE(BM_EstimatorDoGetImage, TG1EdgeEstimator, &G1Edge);
+BENCHMARK_CAPTURE(BM_EstimatorEstimate, TG1EdgeEstimator, &G1Edge);
+BENCHMARK_CAPTURE(BM_EstimatorDoGetImage, TG1MiddleLayerEdgesEstimator, &G1Middle);
+BENCHMARK_CAPTURE(BM_EstimatorEstimate, TG1MiddleLayerEdgesEstimator, &G1Middle);
+
+template<typename TStage>
+static void BM_StageGetImage(benchmark::State &state) {
+    const TStage &stage = TStage::Instance();
+    TCube cube = MakeScrambled();
+    TAllocationsCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(stage.GetImage(cube));
+}
+
+template<typename TStage>
+static void BM_StageEstimate(benchmark::State &state) {
+    const TStage &stage = TStage::Instance();
+    TCube cube = MakeScrambled();
+    TAllocationsCounter allocs(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(stage.Estimate(cube));
+}
+
+BENCHMARK_TEMPLATE(BM_StageGetImage, TG0Stage);
+BENCHMARK_TEMPLATE(BM_StageEstimate, TG0Stage);
+BENCHMARK_TEMPLATE(BM_StageGetImage, TG1Stage);
+BENCHMARK_TEMPLATE(BM_StageEstimate, TG1Stage);
+
+
+BENCHMARK_MAIN();
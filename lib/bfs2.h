@@ -1,32 +1,146 @@
 #pragma once
 
 #include "cube.h"
+#include "frozen_positions.h"
+#include "search_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
 
+// Calls func(index) for every index below threadsCount, the calling thread takes index 0
+template <typename TFunc>
+void RunInThreads(size_t threadsCount, const TFunc &func) {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadsCount; ++i)
+        threads.emplace_back([&func, i]() { func(i); });
+    func(0);
+    for (auto &thread : threads)
+        thread.join();
+}
+
+
+/*
+    PlainBFS - bfs from the solved cube filling the table of a stage.
+    Levels are processed in batches of parents. Threads turn their parts of the batch and keep the children
+    not reached before, then every thread deduplicates its own shard of the children, so nothing is locked.
+    New positions go to the table in the order the serial bfs finds them, so the table does not depend
+    on the number of threads. Small batches and single core machines take the serial path.
+    Only canonical sequences of moves are expanded, the first shortest path to every position is one of them,
+    so the table is the same as with all the moves. No two turns of a canonical sequence are of the same face,
+    so appending a turn to the packed turns of the parent gives the turns of the child.
+*/
 template <typename TStage>
-void PlainBFS(TStage &stage, std::unordered_map<typename TStage::TCubeImageType, TMove> &reachedPositions, size_t depth) {
+void PlainBFS(TStage &stage, std::unordered_map<typename TStage::TCubeImageType, TPackedTurns> &reachedPositions, size_t depth,
+              size_t threadsCount = 0) {
+    using TImage = typename TStage::TCubeImageType;
+    struct TParent {
+        TCube Cube;
+        TPackedTurns Turns;
+        size_t LastMove;                            // Index in the allowed moves, their count for the solved cube
+    };
+    struct TChild {
+        TImage Image;
+        size_t Key;                                 // Index of the parent in the level * moves count + index of the move
+    };
+    struct TNewPosition {
+        TImage Image;
+        size_t Key;
+        TCube Cube;
+        TPackedTurns Turns;
+    };
+    static constexpr size_t BATCH_SIZE = 1 << 16;
+    if (threadsCount == 0)
+        threadsCount = std::max(1u, std::thread::hardware_concurrency());
     const std::vector<TMove> &allowedMoves = stage.GetAllowedMoves();
-    std::vector<TCube> queue;
-    TCube cube = MakeSolvedCube();
-    queue.push_back(cube);
-    reachedPositions[stage.GetImage(cube)] = TMove();
-    for (size_t i = 0; i < queue.size(); ++i) {
-        TCube currentCube = queue[i];
-        TMove currentMove = reachedPositions[stage.GetImage(currentCube)];
-        //std::cout << "Processing " << i << ", queue.size()=" << queue.size() << ", currentMove.GetTotalTurnsCount()=" << currentMove.GetTotalTurnsCount() << std::endl;
-        for (const TMove &move : allowedMoves) {
-            //std::cout << " Turning" << std::endl;
-            cube = move.Act(currentCube);
-            auto img = stage.GetImage(cube);
-            if (reachedPositions.find(img) != reachedPositions.end())
+    const size_t movesCount = allowedMoves.size();
+    const std::vector<unsigned int> &successors = stage.GetCanonicalSuccessors();
+    if (depth > MAX_PACKED_TURNS)
+        throw std::logic_error("Too deep bfs for packed turns.");
+    std::vector<ETurnExt> allowedTurns;
+    for (const TMove &move : allowedMoves) {
+        std::vector<ETurnExt> turns = Turns2Exts(move.GetTurns());
+        if (turns.size() != 1)
+            throw std::logic_error("Allowed move is not a single turn.");
+        allowedTurns.push_back(turns.front());
+    }
+    std::hash<TImage> hasher;
+    std::vector<TParent> level, nextLevel;
+    TCube solved = MakeSolvedCube();
+    reachedPositions[stage.GetImage(solved)] = 0;
+    level.push_back({solved, 0, movesCount});
+    std::vector<std::vector<std::vector<TChild>>> children(threadsCount, std::vector<std::vector<TChild>>(threadsCount));
+    std::vector<std::vector<TNewPosition>> found(threadsCount);
+    std::vector<TNewPosition> merged;
+    while (!level.empty()) {
+        for (size_t begin = 0; begin < level.size(); begin += BATCH_SIZE) {
+            size_t end = std::min(level.size(), begin + BATCH_SIZE);
+            size_t threads = std::min(threadsCount, (end - begin + 255) / 256);
+            if (threads == 1) {
+                for (size_t i = begin; i < end; ++i) {
+                    for (size_t j = 0; j < movesCount; ++j) {
+                        if (!(successors[level[i].LastMove] & (1u << j)))
+                            continue;
+                        TCube cube = allowedMoves[j].Act(level[i].Cube);
+                        TPackedTurns turns = AppendPackedTurn(level[i].Turns, allowedTurns[j]);
+                        if (!reachedPositions.emplace(stage.GetImage(cube), turns).second)
+                            continue;
+                        if (GetPackedTurnsCount(turns) < depth)
+                            nextLevel.push_back({cube, turns, j});
+                    }
+                }
                 continue;
-            //std::cout << " Got new cube" << std::endl;
-            reachedPositions[img] = currentMove * move;
-            if (currentMove.GetTotalTurnsCount() + 1 < depth)
-                queue.push_back(cube);
+            }
+            size_t chunk = (end - begin + threads - 1) / threads;
+            RunInThreads(threads, [&](size_t t) {
+                for (auto &shard : children[t])
+                    shard.clear();
+                for (size_t i = begin + t * chunk; i < std::min(end, begin + (t + 1) * chunk); ++i) {
+                    for (size_t j = 0; j < movesCount; ++j) {
+                        if (!(successors[level[i].LastMove] & (1u << j)))
+                            continue;
+                        TImage img = stage.GetImage(allowedMoves[j].Act(level[i].Cube));
+                        if (reachedPositions.find(img) == reachedPositions.end())
+                            children[t][hasher(img) % threads].push_back({img, i * movesCount + j});
+                    }
+                }
+            });
+            RunInThreads(threads, [&](size_t s) {
+                std::vector<TChild> shard;
+                for (size_t t = 0; t < threads; ++t)
+                    shard.insert(shard.end(), children[t][s].begin(), children[t][s].end());
+                std::sort(shard.begin(), shard.end(), [](const TChild &a, const TChild &b) {
+                    return a.Image < b.Image || (a.Image == b.Image && a.Key < b.Key);
+                });
+                found[s].clear();
+                for (size_t k = 0; k < shard.size(); ++k) {
+                    if (k > 0 && shard[k].Image == shard[k - 1].Image)
+                        continue;
+                    const TParent &parent = level[shard[k].Key / movesCount];
+                    size_t move = shard[k].Key % movesCount;
+                    found[s].push_back({shard[k].Image, shard[k].Key, allowedMoves[move].Act(parent.Cube),
+                                        AppendPackedTurn(parent.Turns, allowedTurns[move])});
+                }
+            });
+            merged.clear();
+            for (size_t s = 0; s < threads; ++s)
+                std::move(found[s].begin(), found[s].end(), std::back_inserter(merged));
+            std::sort(merged.begin(), merged.end(), [](const TNewPosition &a, const TNewPosition &b) {
+                return a.Key < b.Key;
+            });
+            for (const auto &position : merged) {
+                reachedPositions.emplace(position.Image, position.Turns);
+                if (GetPackedTurnsCount(position.Turns) < depth)
+                    nextLevel.push_back({position.Cube, position.Turns, position.Key % movesCount});
+            }
         }
+        level.swap(nextLevel);
+        nextLevel.clear();
     }
 }
 
@@ -47,86 +161,122 @@ bool UpdateReached(const TCube &cube, const TMove &move,
 }
 
 /*
-    BFS2 - two-way bfs, backward moves precomputed
+    BFS2 - two-way bfs, backward moves precomputed.
+    Every generated cube is decoded once and evaluated by the stage, the image of the next stage
+    is made of the same decoded cube when the position is found in the backward table.
+    Nodes are expanded only by the moves keeping their sequence canonical, the starting positions by all the moves.
+    The search stops with the solutions found so far after maxNodesExpanded nodes.
 */
 template<typename TCurrentStage, typename TNextStage>
 std::unordered_map<typename TNextStage::TCubeImageType, TMove>
     BFS2(const TCube &cube,
          const std::vector<TMove> &doneMoves,
          size_t candidatesCount, size_t maxTotalTurnsCount, size_t maxForwardStageTurnsCount, size_t maxStageTurnsCount,
-         const TCurrentStage &currentStage, const TNextStage &nextStage) {
+         const TCurrentStage &currentStage, const TNextStage &nextStage, TStageStats &stats, size_t maxNodesExpanded) {
     using TCurrentCubeImage = typename TCurrentStage::TCubeImageType;
     using TNextCubeImage = typename TNextStage::TCubeImageType;
     using TCurrentReachedMap = std::unordered_map<TCurrentCubeImage, TMove>;
     using TNextReachedMap = std::unordered_map<TNextCubeImage, TMove>;
-    using TQueue = std::list<TCube>;
+    struct TNode {
+        TCube Cube;
+        TCurrentCubeImage Image;
+        size_t LastMove;                            // Index in the allowed moves, their count for the starting positions
+    };
+    using TQueue = std::list<TNode>;
     TQueue queue;
     TCurrentReachedMap reached;
     TNextReachedMap result;
     const auto &allowedMoves = currentStage.GetAllowedMoves();
+    const auto &successors = currentStage.GetCanonicalSuccessors();
     const auto &reachedBackward = currentStage.GetReachedPositions();
+    // Most of the positions are not in the backward table, the filter answers for them without the lookup
+    auto findBackward = [&](const TCurrentCubeImage &img, TMove &move) {
+        if (!currentStage.MayBeReached(img)) {
+            ++stats.BackwardFiltered;
+            return false;
+        }
+        ++stats.HashLookups;
+        return reachedBackward.Find(img, move);
+    };
+    TMove backward;
     for (size_t i = 0; i < doneMoves.size() || !queue.empty(); ) {
-        //std::cout << i << " " << result.size() << " " << (queue.empty() ? -1 : static_cast<int>(reached[currentStage.GetImage(queue.front())].GetTotalTurnsCount())) << " " << queue.size() << " " << reached.size() << " " << reachedBackward.size() << std::endl;
         for (; i < doneMoves.size() && (queue.empty() ||
-               doneMoves[i].GetTotalTurnsCount() <= reached[currentStage.GetImage(queue.front())].GetTotalTurnsCount());
+               doneMoves[i].GetTotalTurnsCount() <= reached[queue.front().Image].GetTotalTurnsCount());
                ++i)
         {
             TMove m = doneMoves[i];
             m.ResetLastStageTurnsCount();
             TCube c = m.Act(cube);
-            auto img = currentStage.GetImage(c);
-            auto it = reachedBackward.find(img);
-            if (it != reachedBackward.end()) {
-                TMove solution = m / it->second;
-                auto img = nextStage.GetImage(c);
+            TCubeColors colors(c);
+            auto evaluation = currentStage.Evaluate(colors);
+            ++stats.NodesGenerated;
+            stats.HashLookups += queue.empty() ? 0 : 1;
+            if (findBackward(evaluation.Image, backward)) {
+                ++stats.BackwardHits;
+                TMove solution = m / backward;
+                auto img = nextStage.GetImage(colors);
                 auto it = result.find(img);
+                ++stats.HashLookups;
                 if (it != result.end()) {
                     if (solution.GetTotalTurnsCount() < it->second.GetTotalTurnsCount())
                         it->second = solution;
                 } else {
                     result[img] = solution;
                 }
-                //std::cout << "i " << i << " " << result.size() << " " << m.GetTotalTurnsCount() << " " << reached.size() << std::endl;
                 if (result.size() >= candidatesCount)
                     return result;
             }
-            int estimate = currentStage.Estimate(c);
-            //std::cout << "i estimate=" << estimate << std::endl;
-            if (estimate == -1) {
-                //std::cout << "est=-1" << std::endl;
+            if (evaluation.Estimate == -1) {
                 result.clear();
                 return result;
             }
-            if (m.GetTotalTurnsCount() + estimate < maxTotalTurnsCount && reached.find(img) == reached.end()) {
-                reached[img] = m;
-                queue.push_front(c);
+            if (m.GetTotalTurnsCount() + evaluation.Estimate >= maxTotalTurnsCount) {
+                ++stats.PrunedByEstimator[evaluation.Strongest];
+                continue;
+            }
+            ++stats.HashLookups;
+            if (reached.find(evaluation.Image) == reached.end()) {
+                reached[evaluation.Image] = m;
+                queue.push_front({c, evaluation.Image, allowedMoves.size()});
             }
         }
         if (!queue.empty()) {
-            TCube cur = queue.front();
+            if (stats.NodesExpanded >= maxNodesExpanded)
+                break;
+            TNode cur = queue.front();
             queue.pop_front();
-            TMove curMove = reached[currentStage.GetImage(cur)];
-            for (const auto &move : allowedMoves) {
-                TCube c = move.Act(cur);
-                TMove m = curMove * move;
-                auto img = currentStage.GetImage(c);
-                if (reached.find(img) == reached.end()) {
-                    int estimate = currentStage.Estimate(c);
-                    if (estimate == -1) {
-                        //std::cout << "est2=-1" << std::endl;
+            TMove curMove = reached[cur.Image];
+            ++stats.NodesExpanded;
+            ++stats.HashLookups;
+            for (size_t j = 0; j < allowedMoves.size(); ++j) {
+                if (!(successors[cur.LastMove] & (1u << j)))
+                    continue;
+                TCube c = allowedMoves[j].Act(cur.Cube);
+                TMove m = curMove * allowedMoves[j];
+                TCubeColors colors(c);
+                auto evaluation = currentStage.Evaluate(colors);
+                ++stats.NodesGenerated;
+                ++stats.HashLookups;
+                if (reached.find(evaluation.Image) == reached.end()) {
+                    if (evaluation.Estimate == -1) {
                         result.clear();
                         return result;
                     }
-                    if (m.GetTotalTurnsCount() + estimate < maxTotalTurnsCount && m.GetLastStageTurnsCount() < maxForwardStageTurnsCount && m.GetLastStageTurnsCount() + estimate < maxStageTurnsCount) {
-                        reached[img] = m;
-                        queue.push_back(c);
-                        //std::cout << "f estimate=" << estimate << "\t" << m.GetTotalTurnsCount() << "\t" << m.GetLastStageTurnsCount() << std::endl;
+                    if (m.GetLastStageTurnsCount() >= maxForwardStageTurnsCount) {
+                        ++stats.PrunedByDepth;
+                    } else if (m.GetTotalTurnsCount() + evaluation.Estimate < maxTotalTurnsCount &&
+                               m.GetLastStageTurnsCount() + evaluation.Estimate < maxStageTurnsCount) {
+                        reached[evaluation.Image] = m;
+                        queue.push_back({c, evaluation.Image, j});
+                    } else {
+                        ++stats.PrunedByEstimator[evaluation.Strongest];
                     }
-                    auto it = reachedBackward.find(img);
-                    if (it != reachedBackward.end()) {
-                        auto solution = m / it->second;
-                        auto img = nextStage.GetImage(c);
+                    if (findBackward(evaluation.Image, backward)) {
+                        ++stats.BackwardHits;
+                        auto solution = m / backward;
+                        auto img = nextStage.GetImage(colors);
                         auto it = result.find(img);
+                        ++stats.HashLookups;
                         if (it != result.end()) {
                             if (solution.GetTotalTurnsCount() < it->second.GetTotalTurnsCount())
                                 it->second = solution;
@@ -135,15 +285,15 @@ std::unordered_map<typename TNextStage::TCubeImageType, TMove>
                         }
                         if (solution.GetTotalTurnsCount() + 1 < maxTotalTurnsCount)
                             maxTotalTurnsCount = solution.GetTotalTurnsCount() + 1;
-                        //std::cout << "f " << i << " " << result.size() << " " << solution.GetTotalTurnsCount() << "=" << m.GetTotalTurnsCount() << "+" << solution.GetTotalTurnsCount() - m.GetTotalaTurnsCount() << " " << reached.size() << std::endl;
                         if (result.size() >= candidatesCount) {
-                            std::cout << reached.size() << std::endl;
+                            stats.PeakReachedSize = reached.size();
                             return result;
                         }
                     }
                 }
             }
         }
+        stats.PeakReachedSize = reached.size();
     }
     return result;
 }
@@ -152,13 +302,20 @@ template<typename TCurrentStage, typename TNextStage>
 std::vector<TMove> Solve(const TCube &cube,
                          const std::vector<TMove> &doneMoves,
                          size_t candidatesCount, size_t maxTotalTurnsCount, size_t maxForwardStageTurnsCount, size_t maxStageTurnsCount,
-                         const TCurrentStage &currentStage, const TNextStage &nextStage) {
+                         const TCurrentStage &currentStage, const TNextStage &nextStage, TStageStats *stats = nullptr,
+                         size_t maxNodesExpanded = std::numeric_limits<size_t>::max()) {
+    TStageStats localStats;
+    auto start = std::chrono::steady_clock::now();
     std::vector<TMove> result;
-    for (auto it : BFS2(cube, doneMoves, candidatesCount, maxTotalTurnsCount, maxForwardStageTurnsCount, maxStageTurnsCount, currentStage, nextStage))
+    for (auto it : BFS2(cube, doneMoves, candidatesCount, maxTotalTurnsCount, maxForwardStageTurnsCount, maxStageTurnsCount, currentStage, nextStage, localStats, maxNodesExpanded))
         result.push_back(it.second);
     std::sort(result.begin(), result.end(), [] (const TMove &a, const TMove &b) {
         return a.GetTotalTurnsCount() < b.GetTotalTurnsCount();
     });
+    if (stats) {
+        localStats.Candidates = result.size();
+        localStats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        *stats = localStats;
+    }
     return result;
 }
-
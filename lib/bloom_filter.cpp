@@ -0,0 +1,23 @@
+#include "bloom_filter.h"
+#include <algorithm>
+
+
+void TBloomFilter::Reset(size_t keysCount, size_t bitsPerKey) {
+    BlocksCount = std::max<size_t>(1, (keysCount * bitsPerKey + BLOCK_WORDS * 64 - 1) / (BLOCK_WORDS * 64));
+    Words.assign(BlocksCount * BLOCK_WORDS + BLOCK_WORDS - 1, 0);
+    size_t misalignment = reinterpret_cast<uintptr_t>(Words.data()) % (BLOCK_WORDS * sizeof(uint64_t));
+    Offset = misalignment ? (BLOCK_WORDS * sizeof(uint64_t) - misalignment) / sizeof(uint64_t) : 0;
+}
+
+void TBloomFilter::Add(uint64_t hash) {
+    uint64_t *block = Words.data() + GetBlockOffset(hash);
+    uint64_t bits = MixHash(hash);
+    for (size_t i = 0; i < BITS_PER_KEY_SET; ++i) {
+        size_t bit = (bits >> (i * 9)) & 511;
+        block[bit / 64] |= (1ULL << (bit % 64));
+    }
+}
+
+size_t TBloomFilter::GetBytes() const {
+    return Words.size() * sizeof(uint64_t);
+}
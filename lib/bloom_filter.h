@@ -0,0 +1,44 @@
+#pragma once
+
+#include "cube.h"
+#include <cstdint>
+#include <vector>
+
+
+/*
+    Blocked bloom filter: all the bits of a key are in one 64-byte block, so a lookup reads a single cache line.
+    Stands in front of the big static tables, where most of the lookups miss.
+*/
+class TBloomFilter {
+    public:
+        void Reset(size_t keysCount, size_t bitsPerKey = 8);
+        void Add(uint64_t hash);
+        size_t GetBytes() const;
+
+        bool MayContain(uint64_t hash) const {
+            if (BlocksCount == 0)
+                return true;
+            const uint64_t *block = Words.data() + GetBlockOffset(hash);
+            uint64_t bits = MixHash(hash);
+            for (size_t i = 0; i < BITS_PER_KEY_SET; ++i) {
+                size_t bit = (bits >> (i * 9)) & 511;
+                if (!(block[bit / 64] & (1ULL << (bit % 64))))
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        static constexpr size_t BLOCK_WORDS = 8;            // 512 bits
+        static constexpr size_t BITS_PER_KEY_SET = 6;       // Bits set by every key in its block, 9 bits of hash each
+
+        std::vector<uint64_t> Words;
+        size_t Offset = 0;                                  // Words before the first block aligned to the cache line
+        size_t BlocksCount = 0;
+
+        // The block is chosen by the high half of the hash, bits inside the block by the mixed hash
+        size_t GetBlockOffset(uint64_t hash) const {
+            size_t block = static_cast<size_t>(((hash >> 32) * BlocksCount) >> 32);
+            return Offset + block * BLOCK_WORDS;
+        }
+};
@@ -1,9 +1,13 @@
 #include "cube.h"
-#include <map>
+#include <cctype>
 #include <sstream>
 
 
 // TCube
+constexpr size_t TCube::CORNERS[];
+constexpr size_t TCube::EDGES[];
+constexpr size_t TCube::OPPOSITE_EDGES[];
+
 EColor TCube::GetColor(size_t field) const {
     size_t result = 0;
     for (size_t i = 0; i < BITS_FOR_COLORS; ++i)
@@ -23,44 +27,15 @@ TCubeImage<(TCube::NUM_FIELDS * TCube::BITS_FOR_COLORS + 7) / 8> TCube::GetImage
     return result;
 }
 
-const std::vector<size_t> &TCube::GetAllCorners() {
-    // r/o, w/y, g/b
-    static std::vector<size_t> Corners = { 13, 0, 42,  15, 2, 16,  8, 29, 40,  10, 31, 18,
-                                           32, 5, 47,  34, 7, 21,  37, 24, 45,  39, 26, 23 };
-    return Corners;
-}
-
-const std::vector<size_t> &TCube::GetAllEdges() {
-    static std::vector<size_t> Edges = { 14, 1,  9, 30,  33, 6,  38, 25,
-                                         11, 41,  12, 17,  35, 46,  36, 22,
-                                         44, 3,  19, 4,  43, 27,  20, 28 };
-    return Edges;
-}
-
-const std::vector<size_t> &TCube::GetTopBottomEdges() {
-    static std::vector<size_t> Edges = { 14, 1,  9, 30,  33, 6,  38, 25,
-                                         11, 41,  12, 17,  35, 46,  36, 22, };
-    return Edges;
-}
-
-const std::vector<size_t> &TCube::GetMiddleEdges() {
-    static std::vector<size_t> Edges = { 44, 3,  19, 4,  43, 27,  20, 28 };
-    return Edges;
-}
-
-size_t TCube::GetOppositeEdge(size_t field) {
-    static std::map<size_t, size_t> EdgesMap = {
-        {25, 38}, {38, 25}, {27, 43}, {43, 27},
-        {28, 20}, {20, 28}, {30, 9}, {9, 30},
-        {11, 41}, {41, 11}, {12, 17}, {17, 12},
-        {14, 1}, {1, 14}, {3, 44}, {44, 3},
-        {4, 19}, {19, 4}, {6, 33}, {33, 6},
-        {35, 46}, {46, 35}, {36, 22}, {22, 36}
-    };
-    auto it = EdgesMap.find(field);
-    if (it == EdgesMap.end())
-        throw std::logic_error("Can't get opposite edge");
-    return it->second;
+bool TCube::SetImage(const TCubeImage<(NUM_FIELDS * BITS_FOR_COLORS + 7) / 8> &image) {
+    TCube cube;
+    std::memcpy(cube.Data, image.Data, sizeof(cube.Data));
+    for (size_t i = 0; i < NUM_FIELDS; ++i) {
+        if (cube.GetColor(i) > C_BLUE)
+            return false;
+    }
+    *this = cube;
+    return true;
 }
 
 bool TCube::operator == (const TCube &rgt) const {
@@ -86,6 +61,18 @@ void TCube::SetBit(size_t bit, size_t value) {
 }
 
 
+// TCubeColors
+TCubeColors::TCubeColors(const TCube &cube) {
+    static_assert(TCube::BITS_FOR_COLORS == 3 && TCube::NUM_FIELDS % 8 == 0, "Eight fields are packed in three bytes.");
+    for (size_t i = 0; i < TCube::NUM_FIELDS / 8; ++i) {
+        const unsigned char *data = cube.Data + i * 3;
+        unsigned int bits = data[0] | (data[1] << 8) | (data[2] << 16);
+        for (size_t j = 0; j < 8; ++j)
+            Colors[i * 8 + j] = (bits >> (j * 3)) & 7;
+    }
+}
+
+
 // TMove
 TMove::TMove()
     : TotalTurnsCount(0)
@@ -120,6 +107,16 @@ TMove::TMove(ETurn id, const std::vector<std::vector<size_t>> &cycles)
     }
 }
 
+TMove::TMove(ETurn id, size_t count, const unsigned char permutation[NUM_FIELDS])
+    : TotalTurnsCount(1)
+    , LastStageTurnsCount(1)
+{
+    for (size_t i = 0; i < count; ++i)
+        AddTurn(id);
+    for (size_t i = 0; i < NUM_FIELDS; ++i)
+        Permutation[i] = permutation[i];
+}
+
 TMove TMove::CloneAsOneMove() const {
     TMove result(*this);
     result.TotalTurnsCount = 1;
@@ -233,41 +230,81 @@ bool TMove::operator < (const TMove &rgt) const {
     return false;
 }
 
-static std::vector<TMove> CreateAllMoves() {
-    std::vector<TMove> moves;
-    moves.reserve(18);
-    TMove f(T_FRONT, {{0, 2, 7, 5}, {1, 4, 6, 3}, {13, 16, 34, 47}, {14, 19, 33, 44}, {15, 21, 32, 42}});
-    TMove u(T_UP, {{8, 10, 15, 13}, {9, 12, 14, 11}, {29, 18, 2, 42}, {30, 17, 1, 41}, {31, 16, 0, 40}});
-    TMove r(T_RIGHT, {{16, 18, 23, 21}, {17, 20, 22, 19}, {15, 31, 39, 7}, {12, 28, 36, 4}, {10, 26, 34, 2}});
-    TMove b(T_BACK, {{29, 24, 26, 31}, {27, 25, 28, 30}, {8, 45, 39, 18}, {9, 43, 38, 20}, {10, 40, 37, 23}});
-    TMove d(T_DOWN, {{32, 34, 39, 37}, {33, 36, 38, 35}, {5, 21, 26, 45}, {6, 22, 25, 46}, {7, 23, 24, 47}});
-    TMove l(T_LEFT, {{40, 42, 47, 45}, {41, 44, 46, 43}, {8, 0, 32, 24}, {11, 3, 35, 27}, {13, 5, 37, 29}});
-    moves.push_back(u);
-    moves.push_back((u * u).CloneAsOneMove());
-    moves.push_back((u * u * u).CloneAsOneMove());
-    moves.push_back(d);
-    moves.push_back((d * d).CloneAsOneMove());
-    moves.push_back((d * d * d).CloneAsOneMove());
-    moves.push_back((l * l).CloneAsOneMove());
-    moves.push_back((r * r).CloneAsOneMove());
-    moves.push_back((f * f).CloneAsOneMove());
-    moves.push_back((b * b).CloneAsOneMove());
-    moves.push_back(l);
-    moves.push_back((l * l * l).CloneAsOneMove());
-    moves.push_back(r);
-    moves.push_back((r * r * r).CloneAsOneMove());
-    moves.push_back(f);
-    moves.push_back((f * f * f).CloneAsOneMove());
-    moves.push_back(b);
-    moves.push_back((b * b * b).CloneAsOneMove());
-    return moves;
-}
+/*
+    Permutations of all ETurnExt in their order, field i goes to Permutation[i].
+    Written out by hand, C++11 can't compose them at compile time. The quarter turn cycles they follow:
+        F: {0, 2, 7, 5}, {1, 4, 6, 3}, {13, 16, 34, 47}, {14, 19, 33, 44}, {15, 21, 32, 42}
+        U: {8, 10, 15, 13}, {9, 12, 14, 11}, {29, 18, 2, 42}, {30, 17, 1, 41}, {31, 16, 0, 40}
+        R: {16, 18, 23, 21}, {17, 20, 22, 19}, {15, 31, 39, 7}, {12, 28, 36, 4}, {10, 26, 34, 2}
+        B: {29, 24, 26, 31}, {27, 25, 28, 30}, {8, 45, 39, 18}, {9, 43, 38, 20}, {10, 40, 37, 23}
+        D: {32, 34, 39, 37}, {33, 36, 38, 35}, {5, 21, 26, 45}, {6, 22, 25, 46}, {7, 23, 24, 47}
+        L: {40, 42, 47, 45}, {41, 44, 46, 43}, {8, 0, 32, 24}, {11, 3, 35, 27}, {13, 5, 37, 29}
+*/
+static constexpr unsigned char MOVE_PERMUTATIONS[][TCube::NUM_FIELDS] = {
+    { 40, 41, 42,  3,  4,  5,  6,  7, 10, 12, 15,  9, 14,  8, 11, 13,  0,  1,  2, 19, 20, 21, 22, 23,                // U
+      24, 25, 26, 27, 28, 18, 17, 16, 32, 33, 34, 35, 36, 37, 38, 39, 31, 30, 29, 43, 44, 45, 46, 47 },
+    { 31, 30, 29,  3,  4,  5,  6,  7, 15, 14, 13, 12, 11, 10,  9,  8, 40, 41, 42, 19, 20, 21, 22, 23,                // U2
+      24, 25, 26, 27, 28,  2,  1,  0, 32, 33, 34, 35, 36, 37, 38, 39, 16, 17, 18, 43, 44, 45, 46, 47 },
+    { 16, 17, 18,  3,  4,  5,  6,  7, 13, 11,  8, 14,  9, 15, 12, 10, 31, 30, 29, 19, 20, 21, 22, 23,                // U'
+      24, 25, 26, 27, 28, 42, 41, 40, 32, 33, 34, 35, 36, 37, 38, 39,  0,  1,  2, 43, 44, 45, 46, 47 },
+    {  0,  1,  2,  3,  4, 21, 22, 23,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 26, 25, 24,                // D
+      47, 46, 45, 27, 28, 29, 30, 31, 34, 36, 39, 33, 38, 32, 35, 37, 40, 41, 42, 43, 44,  5,  6,  7 },
+    {  0,  1,  2,  3,  4, 26, 25, 24,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 45, 46, 47,                // D2
+       7,  6,  5, 27, 28, 29, 30, 31, 39, 38, 37, 36, 35, 34, 33, 32, 40, 41, 42, 43, 44, 21, 22, 23 },
+    {  0,  1,  2,  3,  4, 45, 46, 47,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,  5,  6,  7,                // D'
+      23, 22, 21, 27, 28, 29, 30, 31, 37, 35, 32, 38, 33, 39, 36, 34, 40, 41, 42, 43, 44, 26, 25, 24 },
+    { 24,  1,  2, 27,  4, 29,  6,  7, 32,  9, 10, 35, 12, 37, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,                // L2
+       0, 25, 26,  3, 28,  5, 30, 31,  8, 33, 34, 11, 36, 13, 38, 39, 47, 46, 45, 44, 43, 42, 41, 40 },
+    {  0,  1, 26,  3, 28,  5,  6, 31,  8,  9, 34, 11, 36, 13, 14, 39, 23, 22, 21, 20, 19, 18, 17, 16,                // R2
+      24, 25,  2, 27,  4, 29, 30,  7, 32, 33, 10, 35, 12, 37, 38, 15, 40, 41, 42, 43, 44, 45, 46, 47 },
+    {  7,  6,  5,  4,  3,  2,  1,  0,  8,  9, 10, 11, 12, 34, 33, 32, 47, 17, 18, 44, 20, 42, 22, 23,                // F2
+      24, 25, 26, 27, 28, 29, 30, 31, 15, 14, 13, 35, 36, 37, 38, 39, 40, 41, 21, 43, 19, 45, 46, 16 },
+    {  0,  1,  2,  3,  4,  5,  6,  7, 39, 38, 37, 11, 12, 13, 14, 15, 16, 17, 45, 19, 43, 21, 22, 40,                // B2
+      31, 30, 29, 28, 27, 26, 25, 24, 32, 33, 34, 35, 36, 10,  9,  8, 23, 41, 42, 20, 44, 18, 46, 47 },
+    { 32,  1,  2, 35,  4, 37,  6,  7,  0,  9, 10,  3, 12,  5, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,                // L
+       8, 25, 26, 11, 28, 13, 30, 31, 24, 33, 34, 27, 36, 29, 38, 39, 42, 44, 47, 41, 46, 40, 43, 45 },
+    {  8,  1,  2, 11,  4, 13,  6,  7, 24,  9, 10, 27, 12, 29, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,                // L'
+      32, 25, 26, 35, 28, 37, 30, 31,  0, 33, 34,  3, 36,  5, 38, 39, 45, 43, 40, 46, 41, 47, 44, 42 },
+    {  0,  1, 10,  3, 12,  5,  6, 15,  8,  9, 26, 11, 28, 13, 14, 31, 18, 20, 23, 17, 22, 16, 19, 21,                // R
+      24, 25, 34, 27, 36, 29, 30, 39, 32, 33,  2, 35,  4, 37, 38,  7, 40, 41, 42, 43, 44, 45, 46, 47 },
+    {  0,  1, 34,  3, 36,  5,  6, 39,  8,  9,  2, 11,  4, 13, 14,  7, 21, 19, 16, 22, 17, 23, 20, 18,                // R'
+      24, 25, 10, 27, 12, 29, 30, 15, 32, 33, 26, 35, 28, 37, 38, 31, 40, 41, 42, 43, 44, 45, 46, 47 },
+    {  2,  4,  7,  1,  6,  0,  3,  5,  8,  9, 10, 11, 12, 16, 19, 21, 34, 17, 18, 33, 20, 32, 22, 23,                // F
+      24, 25, 26, 27, 28, 29, 30, 31, 42, 44, 47, 35, 36, 37, 38, 39, 40, 41, 15, 43, 14, 45, 46, 13 },
+    {  5,  3,  0,  6,  1,  7,  4,  2,  8,  9, 10, 11, 12, 47, 44, 42, 13, 17, 18, 14, 20, 15, 22, 23,                // F'
+      24, 25, 26, 27, 28, 29, 30, 31, 21, 19, 16, 35, 36, 37, 38, 39, 40, 41, 32, 43, 33, 45, 46, 34 },
+    {  0,  1,  2,  3,  4,  5,  6,  7, 45, 43, 40, 11, 12, 13, 14, 15, 16, 17,  8, 19,  9, 21, 22, 10,                // B
+      26, 28, 31, 25, 30, 24, 27, 29, 32, 33, 34, 35, 36, 23, 20, 18, 37, 41, 42, 38, 44, 39, 46, 47 },
+    {  0,  1,  2,  3,  4,  5,  6,  7, 18, 20, 23, 11, 12, 13, 14, 15, 16, 17, 39, 19, 38, 21, 22, 37,                // B'
+      29, 27, 24, 30, 25, 31, 28, 26, 32, 33, 34, 35, 36, 40, 43, 45, 10, 41, 42,  9, 44,  8, 46, 47 },
+};
+
+static const TMove MOVES[] = {
+    TMove(T_UP, 1, MOVE_PERMUTATIONS[TE_U]),
+    TMove(T_UP, 2, MOVE_PERMUTATIONS[TE_U2]),
+    TMove(T_UP, 3, MOVE_PERMUTATIONS[TE_U1]),
+    TMove(T_DOWN, 1, MOVE_PERMUTATIONS[TE_D]),
+    TMove(T_DOWN, 2, MOVE_PERMUTATIONS[TE_D2]),
+    TMove(T_DOWN, 3, MOVE_PERMUTATIONS[TE_D1]),
+    TMove(T_LEFT, 2, MOVE_PERMUTATIONS[TE_L2]),
+    TMove(T_RIGHT, 2, MOVE_PERMUTATIONS[TE_R2]),
+    TMove(T_FRONT, 2, MOVE_PERMUTATIONS[TE_F2]),
+    TMove(T_BACK, 2, MOVE_PERMUTATIONS[TE_B2]),
+    TMove(T_LEFT, 1, MOVE_PERMUTATIONS[TE_L]),
+    TMove(T_LEFT, 3, MOVE_PERMUTATIONS[TE_L1]),
+    TMove(T_RIGHT, 1, MOVE_PERMUTATIONS[TE_R]),
+    TMove(T_RIGHT, 3, MOVE_PERMUTATIONS[TE_R1]),
+    TMove(T_FRONT, 1, MOVE_PERMUTATIONS[TE_F]),
+    TMove(T_FRONT, 3, MOVE_PERMUTATIONS[TE_F1]),
+    TMove(T_BACK, 1, MOVE_PERMUTATIONS[TE_B]),
+    TMove(T_BACK, 3, MOVE_PERMUTATIONS[TE_B1])
+};
+static_assert(sizeof(MOVE_PERMUTATIONS) / sizeof(*MOVE_PERMUTATIONS) == TE_B1 + 1, "Every ETurnExt needs a permutation.");
 
 const TMove &TurnExt2Move(ETurnExt turn) {
-    static std::vector<TMove> Moves(CreateAllMoves());
-    if (turn < 0 || turn >= Moves.size())
+    if (turn < 0 || turn >= sizeof(MOVES) / sizeof(*MOVES))
         throw std::logic_error("Turn is out of bounds.");
-    return Moves[turn];
+    return MOVES[turn];
 }
 
 std::string TurnExt2String(ETurnExt turn) {
@@ -309,33 +346,120 @@ std::vector<ETurnExt> Turns2Exts(const std::vector<ETurn> &turns) {
     return result;
 }
 
+// Face and quarter turns of an extended turn
+static void Ext2Turn(ETurnExt turn, ETurn &face, size_t &count) {
+    for (size_t f = T_FRONT; f <= T_LEFT; ++f) {
+        for (size_t c = 1; c <= 3; ++c) {
+            if (Turn2Ext(static_cast<ETurn>(f), c) == turn) {
+                face = static_cast<ETurn>(f);
+                count = c;
+                return;
+            }
+        }
+    }
+    throw std::logic_error("Undefined turn id.");
+}
 
-const std::map<char, EColor> char2color = {
-    {'w', C_WHITE},
-    {'y', C_YELLOW},
-    {'r', C_RED},
-    {'o', C_ORANGE},
-    {'g', C_GREEN},
-    {'b', C_BLUE},
-};
+ETurnExt InvertTurnExt(ETurnExt turn) {
+    ETurn face;
+    size_t count;
+    Ext2Turn(turn, face, count);
+    return Turn2Ext(face, 4 - count);
+}
+
+std::vector<ETurnExt> SimplifyTurns(const std::vector<ETurnExt> &turns) {
+    std::vector<std::pair<ETurn, size_t>> result;        // Face and quarter turns
+    for (ETurnExt turn : turns) {
+        ETurn face;
+        size_t count;
+        Ext2Turn(turn, face, count);
+        size_t target = result.size();
+        if (!result.empty() && result.back().first == face)
+            target = result.size() - 1;
+        else if (result.size() >= 2 && (result.back().first + 3) % 6 == face && result[result.size() - 2].first == face)
+            target = result.size() - 2;                  // ETurn lists opposite faces 3 apart
+        if (target == result.size()) {
+            result.push_back({face, count});
+            continue;
+        }
+        result[target].second = (result[target].second + count) % 4;
+        if (result[target].second == 0)
+            result.erase(result.begin() + target);
+    }
+    std::vector<ETurnExt> exts;
+    for (const auto &turn : result)
+        exts.push_back(Turn2Ext(turn.first, turn.second));
+    return exts;
+}
+
+std::vector<unsigned int> MakeCanonicalSuccessors(const std::vector<TMove> &moves) {
+    if (moves.size() > sizeof(unsigned int) * 8)
+        throw std::logic_error("Too many moves for successor masks.");
+    std::vector<ETurn> faces;
+    for (const TMove &move : moves) {
+        std::vector<ETurn> turns = move.GetTurns();
+        if (turns.empty() || std::count(turns.begin(), turns.end(), turns.front()) != static_cast<int>(turns.size()))
+            throw std::logic_error("Move must turn one face.");
+        faces.push_back(turns.front());
+    }
+    std::vector<unsigned int> result(moves.size() + 1, 0);
+    for (size_t j = 0; j < moves.size(); ++j)
+        result[moves.size()] |= (1u << j);
+    for (size_t i = 0; i < moves.size(); ++i) {
+        for (size_t j = 0; j < moves.size(); ++j) {
+            if (faces[j] == faces[i])
+                continue;
+            if ((faces[j] + 3) % 6 == faces[i] && j < i)        // ETurn lists opposite faces 3 apart
+                continue;
+            result[i] |= (1u << j);
+        }
+    }
+    return result;
+}
+
+
+static bool Char2Color(char ch, EColor &color) {
+    switch (std::tolower(static_cast<unsigned char>(ch))) {
+        case 'w': color = C_WHITE; return true;
+        case 'y': color = C_YELLOW; return true;
+        case 'r': color = C_RED; return true;
+        case 'o': color = C_ORANGE; return true;
+        case 'g': color = C_GREEN; return true;
+        case 'b': color = C_BLUE; return true;
+        default: return false;
+    }
+}
 
 TCube MakePuzzle(std::string colors) {
     colors.erase(std::remove(colors.begin(), colors.end(), ' '), colors.end());
-    //std::cout << colors.size() << std::endl;
+    if (colors.size() < TCube::NUM_FIELDS)
+        throw std::logic_error("Too few colors.");
     TCube cube;
-    for (size_t i = 0; i < 48; ++i) {
-        char clr = std::tolower(colors[i]);
-        auto it = char2color.find(clr);
-        if (it == char2color.cend()) {
+    for (size_t i = 0; i < TCube::NUM_FIELDS; ++i) {
+        EColor color;
+        if (!Char2Color(colors[i], color)) {
             std::stringstream err;
-            err << "Unknown color: '" << clr << "'";
+            err << "Unknown color: '" << static_cast<char>(std::tolower(colors[i])) << "'";
             throw std::logic_error(err.str());
         }
-        cube.SetColor(i, it->second);
+        cube.SetColor(i, color);
     }
     return cube;
 }
 
+bool ParsePuzzle(const char *colors, size_t size, TCube &cube) {
+    size_t field = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (std::isspace(static_cast<unsigned char>(colors[i])))
+            continue;
+        EColor color;
+        if (field == TCube::NUM_FIELDS || !Char2Color(colors[i], color))
+            return false;
+        cube.SetColor(field++, color);
+    }
+    return field == TCube::NUM_FIELDS;
+}
+
 TCube MakeSolvedCube() {
     TCube zero;
     for (size_t i = 0; i < TCube::NUM_FIELDS; ++i)
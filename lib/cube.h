@@ -2,11 +2,14 @@
 
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <unordered_map>
 #include <set>
 #include <list>
 #include <exception>
+#include <stdexcept>
 #include <string>
 #include <algorithm>
 #include <iostream>
@@ -80,6 +83,29 @@ namespace std {
 } // namespace std
 
 
+// Finalizer of murmur3
+inline uint64_t MixHash(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+// Cheaper than std::hash of the image, for the tables built once
+template<size_t N>
+uint64_t GetImageHash(const TCubeImage<N> &image) {
+    uint64_t result = 0x9E3779B97F4A7C15ULL * (N + 1);
+    for (size_t i = 0; i < N; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, image.Data + i, N - i < 8 ? N - i : 8);
+        result = MixHash(result ^ word);
+    }
+    return result;
+}
+
+
 /*
 
           24 25 26
@@ -104,19 +130,42 @@ class TCube {
     public:
         static constexpr size_t NUM_FIELDS = 48;
         static constexpr size_t BITS_FOR_COLORS = 3;
+        static constexpr size_t NUM_CORNERS = 8;
+        static constexpr size_t NUM_EDGES = 12;
+        static constexpr size_t NUM_TOP_BOTTOM_EDGES = 8;               // The first ones in EDGES, the rest are middle layer edges
+
+        // Fields of every corner: r/o, w/y, g/b
+        static constexpr size_t CORNERS[NUM_CORNERS * 3] = {
+            13, 0, 42,  15, 2, 16,  8, 29, 40,  10, 31, 18,
+            32, 5, 47,  34, 7, 21,  37, 24, 45,  39, 26, 23
+        };
+        // Fields of every edge, the second field is opposite to the first one
+        static constexpr size_t EDGES[NUM_EDGES * 2] = {
+            14, 1,  9, 30,  33, 6,  38, 25,
+            11, 41,  12, 17,  35, 46,  36, 22,
+            44, 3,  19, 4,  43, 27,  20, 28
+        };
+        // The other field of the same edge, NUM_FIELDS for non-edge fields
+        static constexpr size_t OPPOSITE_EDGES[NUM_FIELDS] = {
+            48, 14, 48, 44, 19, 48, 33, 48,  48, 30, 48, 41, 17, 48, 1, 48,
+            48, 12, 48, 4, 28, 48, 36, 48,  48, 38, 48, 43, 20, 48, 9, 48,
+            48, 6, 48, 46, 22, 48, 25, 48,  48, 11, 48, 27, 3, 48, 35, 48
+        };
 
         EColor GetColor(size_t field) const;
         void SetColor(size_t field, EColor color);
         TCubeImage<(NUM_FIELDS * BITS_FOR_COLORS + 7) / 8> GetImage() const;
-        static const std::vector<size_t> &GetAllCorners();
-        static const std::vector<size_t> &GetAllEdges();
-        static const std::vector<size_t> &GetTopBottomEdges();
-        static const std::vector<size_t> &GetMiddleEdges();
-        static size_t GetOppositeEdge(size_t field);
+        bool SetImage(const TCubeImage<(NUM_FIELDS * BITS_FOR_COLORS + 7) / 8> &image);   // False if some field has no color, the cube is kept then
+        static constexpr size_t GetOppositeEdge(size_t field) {
+            return field < NUM_FIELDS && OPPOSITE_EDGES[field] != NUM_FIELDS ? OPPOSITE_EDGES[field]
+                                                                            : throw std::logic_error("Can't get opposite edge");
+        }
         bool operator == (const TCube &rgt) const;
         bool operator != (const TCube &rgt) const;
 
     private:
+        friend class TCubeColors;
+
         unsigned char Data[(NUM_FIELDS * BITS_FOR_COLORS + 7) / 8];
 
         size_t GetBit(size_t bit) const;
@@ -124,6 +173,20 @@ class TCube {
 };
 
 
+// Colors of all fields decoded at once, for the code reading many fields of the same cube
+class TCubeColors {
+    public:
+        explicit TCubeColors(const TCube &cube);
+
+        EColor GetColor(size_t field) const {
+            return static_cast<EColor>(Colors[field]);
+        }
+
+    private:
+        unsigned char Colors[TCube::NUM_FIELDS];
+};
+
+
 
 class TMove {
     public:
@@ -132,6 +195,7 @@ class TMove {
         TMove();
         TMove(ETurn id, const size_t permutation[NUM_FIELDS]);
         TMove(ETurn id, const std::vector<std::vector<size_t>> &cycles);    // Construct from independent cycles.
+        TMove(ETurn id, size_t count, const unsigned char permutation[NUM_FIELDS]);    // id repeated count times as one move
         TMove CloneAsOneMove() const;
         TMove &operator *= (const TMove &rgt);
         TMove &operator /= (const TMove &rgt);
@@ -155,11 +219,22 @@ TMove operator * (TMove lft, const TMove &rgt);
 TMove operator / (TMove lft, const TMove &rgt);
 
 
-const TMove &TurnExt2Move(ETurnExt turn);
+const TMove &TurnExt2Move(ETurnExt turn);                          // turn must be a valid ETurnExt
 std::string TurnExt2String(ETurnExt turn);
 std::vector<ETurnExt> Turns2Exts(const std::vector<ETurn> &turns);
+ETurnExt InvertTurnExt(ETurnExt turn);
+// Merges turns of the same face separated by nothing or by turns of the opposite face only, dropping those cancelled out
+std::vector<ETurnExt> SimplifyTurns(const std::vector<ETurnExt> &turns);
+
+/*
+    Canonical sequences of moves: a face is not turned twice in a row and turns of opposite faces commute,
+    so of the two orders only the one following the order of moves is kept.
+    Result[i] has bit j set if moves[j] may follow moves[i], Result[moves.size()] allows every move first.
+*/
+std::vector<unsigned int> MakeCanonicalSuccessors(const std::vector<TMove> &moves);
 
 
 TCube MakePuzzle(std::string colors);
+bool ParsePuzzle(const char *colors, size_t size, TCube &cube);      // As MakePuzzle, spaces and case ignored, false on wrong colors
 TCube MakeSolvedCube();
 
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "cube.h"
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+    Sequence of up to 12 turns packed in 64 bits: the count in the low 4 bits, then 5 bits per turn.
+    The bfs of the stages keeps its moves this way, so its table holds no vectors.
+*/
+using TPackedTurns = uint64_t;
+
+static constexpr size_t MAX_PACKED_TURNS = 12;
+
+inline size_t GetPackedTurnsCount(TPackedTurns turns) {
+    return turns & 15;
+}
+
+inline TPackedTurns AppendPackedTurn(TPackedTurns turns, ETurnExt turn) {
+    return (turns | static_cast<TPackedTurns>(turn) << (4 + GetPackedTurnsCount(turns) * 5)) + 1;
+}
+
+// Loaded tables are checked with this, a bad count or turn would read past the move tables
+inline bool IsValidPackedTurns(TPackedTurns turns) {
+    size_t count = GetPackedTurnsCount(turns);
+    if (count > MAX_PACKED_TURNS || (turns >> (4 + count * 5)) != 0)
+        return false;
+    for (size_t i = 0; i < count; ++i) {
+        if (((turns >> (4 + i * 5)) & 31) > TE_B1)
+            return false;
+    }
+    return true;
+}
+
+inline TMove UnpackTurns(TPackedTurns turns) {
+    TMove result;
+    for (size_t i = 0; i < GetPackedTurnsCount(turns); ++i)
+        result *= TurnExt2Move(static_cast<ETurnExt>((turns >> (4 + i * 5)) & 31));
+    return result;
+}
+
+
+/*
+    Table of positions frozen after the bfs. Entries are sorted by the high bits of the hash of their images
+    and a directory keeps where every bucket starts, so a lookup reads the directory and a few neighbouring
+    images, compared in full. Moves are made of their packed turns on hits only.
+    Saved in the native byte order, a table is loaded on the machine it was saved on.
+    The tag given to Save identifies how the table was made (depth, moves, hash), Load refuses other tags.
+    Load also checks the size of the file, the directory, the bucket of every image and every packed turns.
+*/
+template<size_t N>
+class TFrozenPositions {
+    public:
+        using TImage = TCubeImage<N>;
+
+        void Build(const std::unordered_map<TImage, TPackedTurns> &positions) {
+            struct TEntry {
+                uint64_t Bucket;
+                TImage Image;
+                TPackedTurns Turns;
+            };
+            BucketsBits = GetBucketsBits(positions.size());
+            std::vector<TEntry> sorted;
+            sorted.reserve(positions.size());
+            for (const auto &position : positions)
+                sorted.push_back({GetBucket(position.first), position.first, position.second});
+            std::sort(sorted.begin(), sorted.end(), [](const TEntry &a, const TEntry &b) {
+                return a.Bucket < b.Bucket || (a.Bucket == b.Bucket && a.Image < b.Image);
+            });
+            Directory.assign((static_cast<size_t>(1) << BucketsBits) + 1, 0);
+            Images.resize(sorted.size());
+            Turns.resize(sorted.size());
+            for (size_t i = 0; i < sorted.size(); ++i) {
+                ++Directory[sorted[i].Bucket + 1];
+                Images[i] = sorted[i].Image;
+                Turns[i] = sorted[i].Turns;
+            }
+            for (size_t i = 1; i < Directory.size(); ++i)
+                Directory[i] += Directory[i - 1];
+        }
+
+        bool Find(const TImage &image, TMove &move) const {
+            if (Images.empty())
+                return false;
+            uint64_t bucket = GetBucket(image);
+            for (uint32_t i = Directory[bucket]; i < Directory[bucket + 1]; ++i) {
+                if (std::memcmp(Images[i].Data, image.Data, N) == 0) {
+                    move = UnpackTurns(Turns[i]);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        size_t GetSize() const {
+            return Images.size();
+        }
+
+        const TImage &GetImage(size_t index) const {
+            return Images[index];
+        }
+
+        TMove GetMove(size_t index) const {
+            return UnpackTurns(Turns[index]);
+        }
+
+        size_t GetBytes() const {
+            return Directory.size() * sizeof(uint32_t) + Images.size() * sizeof(TImage) + Turns.size() * sizeof(TPackedTurns);
+        }
+
+        void Save(std::ostream &out, uint64_t tag) const {
+            uint64_t header[HEADER_SIZE] = { MAGIC, N, tag, BucketsBits, Images.size() };
+            out.write(reinterpret_cast<const char *>(header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(Directory.data()), Directory.size() * sizeof(uint32_t));
+            out.write(reinterpret_cast<const char *>(Images.data()), Images.size() * sizeof(TImage));
+            out.write(reinterpret_cast<const char *>(Turns.data()), Turns.size() * sizeof(TPackedTurns));
+        }
+
+        // False if the stream does not hold a valid table with this tag, the table is left empty then
+        bool Load(std::istream &in, uint64_t tag) {
+            bool good = DoLoad(in, tag);
+            if (!good) {
+                BucketsBits = 0;
+                Directory.clear();
+                Images.clear();
+                Turns.clear();
+            }
+            return good;
+        }
+
+    private:
+        static constexpr uint64_t MAGIC = 0x325A52464B425552ULL;        // "RUBKFRZ2"
+        static constexpr size_t HEADER_SIZE = 5;                        // Magic, N, tag, buckets bits, count
+
+        size_t BucketsBits = 0;
+        std::vector<uint32_t> Directory;                                // First entry of every bucket and the total count
+        std::vector<TImage> Images;
+        std::vector<TPackedTurns> Turns;
+
+        uint64_t GetBucket(const TImage &image) const {
+            return GetImageHash(image) >> (64 - BucketsBits);
+        }
+
+        // About 4 entries per bucket
+        static size_t GetBucketsBits(size_t count) {
+            size_t bits = 1;
+            while ((static_cast<size_t>(1) << bits) * 4 < count)
+                ++bits;
+            return bits;
+        }
+
+        bool DoLoad(std::istream &in, uint64_t tag) {
+            uint64_t header[HEADER_SIZE];
+            if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != MAGIC || header[1] != N ||
+                header[2] != tag || header[4] > UINT32_MAX || header[3] != GetBucketsBits(header[4]))
+                return false;
+            // The rest of the stream must be the table, nothing is allocated for sizes a broken header claims
+            size_t count = header[4];
+            size_t bucketsCount = static_cast<size_t>(1) << header[3];
+            std::streamoff expected = (bucketsCount + 1) * sizeof(uint32_t) + count * (sizeof(TImage) + sizeof(TPackedTurns));
+            std::streampos start = in.tellg();
+            if (start == std::streampos(-1) || !in.seekg(0, std::ios::end) || in.tellg() - start != expected ||
+                !in.seekg(start))
+                return false;
+            BucketsBits = header[3];
+            Directory.resize(bucketsCount + 1);
+            Images.resize(count);
+            Turns.resize(count);
+            in.read(reinterpret_cast<char *>(Directory.data()), Directory.size() * sizeof(uint32_t));
+            in.read(reinterpret_cast<char *>(Images.data()), Images.size() * sizeof(TImage));
+            in.read(reinterpret_cast<char *>(Turns.data()), Turns.size() * sizeof(TPackedTurns));
+            if (in.fail() || Directory.front() != 0 || Directory.back() != count)
+                return false;
+            for (size_t bucket = 0; bucket < bucketsCount; ++bucket) {
+                if (Directory[bucket] > Directory[bucket + 1])
+                    return false;
+                for (uint32_t i = Directory[bucket]; i < Directory[bucket + 1]; ++i) {
+                    if (GetBucket(Images[i]) != bucket || !IsValidPackedTurns(Turns[i]))
+                        return false;
+                }
+            }
+            return true;
+        }
+};
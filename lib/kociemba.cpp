@@ -1,8 +1,13 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
 #include "bfs2.h"
 #include "cube.h"
 #include "kociemba.h"
 #include "kociemba_impl.h"
+#include "logger.h"
 
 
 TMove ReplayTurns(std::vector<ETurnExt>::const_iterator begin, std::vector<ETurnExt>::const_iterator end) {
@@ -13,44 +18,112 @@ TMove ReplayTurns(std::vector<ETurnExt>::const_iterator begin, std::vector<ETurn
 }
 
 
-/*std::vector<ETurnExt> ReduceSolution(const TCube &puzzle, const std::vector<ETurnExt> &solution,
-                                     const std::vector<TMove> &g0, TIsomorphism &iso)
-{
-    std::vector<ETurnExt> result(solution);
-    size_t windowSize = solution.size() >= 10 ? 10 : solution.size();
-    TMove current;
-    for (std::vector<ETurnExt>::const_iterator begin = solution.begin(), it = solution.begin(), end = solution.end();
-         it + windowSize < end;
-         current *= TurnExt2Move(*it), ++it)
-    {
-        TCube from = current.Act(puzzle);
-        TCube to = ReplayTurns(it, it + windowSize).Act(from);
-        auto candidates = Solve(from, to, {TMove()}, 1, 3000000, g0, iso, iso);
-        if (candidates.empty())
-            continue;
-        TMove m = current * candidates.front() * ReplayTurns(it + windowSize, end);
-        auto turns = Turns2Exts(m.GetTurns());
-        if (turns.size() < result.size())
-            result = turns;
+// Turns doing the same as the window turns[begin, end) and shorter than it, false if none are found within the budget
+static bool SolveWindow(const std::vector<ETurnExt> &turns, size_t begin, size_t end, size_t maxNodesExpanded,
+                        std::vector<ETurnExt> &result) {
+    auto &g0 = TG0Stage::Instance();
+    auto &g1 = TG1Stage::Instance();
+    // The window solves the position made of the solved cube by its inverse
+    TMove inverse;
+    for (size_t i = end; i > begin; --i)
+        inverse *= TurnExt2Move(InvertTurnExt(turns[i - 1]));
+    TCube puzzle = inverse.Act(MakeSolvedCube());
+    size_t maxTotalTurnsCount = end - begin;
+    auto candidates = Solve(puzzle, {TMove()}, 5000, maxTotalTurnsCount, 6, 12, g0, g1, nullptr, maxNodesExpanded);
+    if (candidates.empty())
+        return false;
+    auto solution = Solve(puzzle, candidates, 5000, maxTotalTurnsCount, 8, 14, g1, g1, nullptr, maxNodesExpanded);
+    if (solution.empty())
+        return false;
+    result = Turns2Exts(solution.front().GetTurns());
+    return result.size() < maxTotalTurnsCount;
+}
+
+/*
+    Windows of the solution are solved again independently by threads. Of the shorter solutions of windows
+    the non-overlapping ones saving the most turns replace them, then turns left next to each other are merged.
+*/
+static std::vector<ETurnExt> ReduceSolution(const std::vector<ETurnExt> &solution, const TReduceOptions &options) {
+    std::vector<ETurnExt> turns = SimplifyTurns(solution);
+    size_t window = std::min(options.WindowSize, turns.size());
+    if (window < 2)
+        return turns;
+    size_t windowsCount = turns.size() - window + 1;
+    std::vector<std::vector<ETurnExt>> replacements(windowsCount);
+    std::vector<char> found(windowsCount, 0);
+    std::atomic<size_t> next(0);
+    size_t threadsCount = options.ThreadsCount != 0 ? options.ThreadsCount : std::max(1u, std::thread::hardware_concurrency());
+    RunInThreads(std::min(threadsCount, windowsCount), [&](size_t) {
+        for (size_t i = next++; i < windowsCount; i = next++)
+            found[i] = SolveWindow(turns, i, i + window, options.MaxNodesExpanded, replacements[i]) ? 1 : 0;
+    });
+    // saved[i] - most turns saved by the replacements inside turns[i, end)
+    auto gain = [&](size_t i) {
+        return window - replacements[i].size();
+    };
+    std::vector<size_t> saved(turns.size() + 1, 0);
+    for (size_t i = turns.size(); i-- > 0; ) {
+        saved[i] = saved[i + 1];
+        if (i < windowsCount && found[i])
+            saved[i] = std::max(saved[i], gain(i) + saved[i + window]);
     }
-    return result;
-}*/
+    std::vector<ETurnExt> result;
+    for (size_t i = 0; i < turns.size(); ) {
+        if (i < windowsCount && found[i] && saved[i] == gain(i) + saved[i + window]) {
+            result.insert(result.end(), replacements[i].begin(), replacements[i].end());
+            i += window;
+        } else {
+            result.push_back(turns[i++]);
+        }
+    }
+    return SimplifyTurns(result);
+}
 
-void InitKociemba() {
+// Stages have their own tables and estimators, so they are built at the same time
+void InitKociemba(const std::string &tablesDir) {
+    SetTablesDir(tablesDir);
+    std::thread g1([]() { TG1Stage::Instance(); });
     TG0Stage::Instance();
-    TG1Stage::Instance();
+    g1.join();
 }
 
-bool KociembaSolution(const TCube &puzzle, std::vector<ETurnExt> &result) {
+int KociembaEstimate(const TCube &puzzle) {
+    // Colors that parse may still be no cube, the estimators refuse such cubies
+    try {
+        return TG0Stage::Instance().Estimate(puzzle);
+    } catch (const std::logic_error &) {
+        return -1;
+    }
+}
+
+bool KociembaSolution(const TCube &puzzle, std::vector<ETurnExt> &result, TSolveStats *stats,
+                      const TReduceOptions *reduce) {
     auto &g0 = TG0Stage::Instance();
     auto &g1 = TG1Stage::Instance();
-    auto candidates = Solve(puzzle, {TMove()}, 5000, 12, 6, 12, g0, g1);
-    std::cout << "Stage 1: " << (!candidates.empty() ? Turns2Exts(candidates.front().GetTurns()).size() : 0) << std::endl;
-    auto solution = Solve(puzzle, candidates, 5000, 20, 8, 14, g1, g1);
-    std::cout << "Stage 2: " << (!solution.empty() ? Turns2Exts(solution.front().GetTurns()).size() : 0) << std::endl;
-    if (solution.empty())
-        return false;
-    result = Turns2Exts(solution.front().GetTurns());
-    return true;
+    TSolveStats localStats;
+    auto candidates = Solve(puzzle, {TMove()}, 5000, 12, 6, 12, g0, g1, &localStats.Stages[0]);
+    LOGGER_DEBUG("Stage 1: " << (!candidates.empty() ? Turns2Exts(candidates.front().GetTurns()).size() : 0));
+    auto solution = Solve(puzzle, candidates, 5000, 20, 8, 14, g1, g1, &localStats.Stages[1]);
+    LOGGER_DEBUG("Stage 2: " << (!solution.empty() ? Turns2Exts(solution.front().GetTurns()).size() : 0));
+    if (!solution.empty()) {
+        result = Turns2Exts(solution.front().GetTurns());
+        if (reduce) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<ETurnExt> reduced = ReduceSolution(result, *reduce);
+            // Replacements are checked on the puzzle, a wrong one would give a wrong answer
+            if (reduced.size() < result.size() &&
+                ReplayTurns(reduced.begin(), reduced.end()).Act(puzzle) == ReplayTurns(result.begin(), result.end()).Act(puzzle))
+            {
+                LOGGER_DEBUG("Reduced: " << result.size() << " -> " << reduced.size());
+                localStats.TurnsSaved = result.size() - reduced.size();
+                result.swap(reduced);
+            }
+            localStats.ReduceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    if (stats) {
+        localStats.Seconds = localStats.Stages[0].Seconds + localStats.Stages[1].Seconds + localStats.ReduceSeconds;
+        *stats = localStats;
+    }
+    return !solution.empty();
 }
-
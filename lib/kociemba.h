@@ -1,7 +1,21 @@
+#pragma once
+
 #include "cube.h"
+#include "search_stats.h"
+#include <string>
 #include <vector>
 
-void InitKociemba();
-bool KociembaSolution(const TCube &puzzle, std::vector<ETurnExt> &result);
+// Post-pass shortening the solution: every window of it is solved again, shorter solutions of windows replace them
+struct TReduceOptions {
+    size_t WindowSize = 10;                         // Turns of the solution solved again at once
+    size_t MaxNodesExpanded = 20000;                // Budget of every stage of the search in a window
+    size_t ThreadsCount = 0;                        // Threads solving windows, 0 for the number of cores
+};
+
+void InitKociemba(const std::string &tablesDir = std::string());      // Tables are loaded from tablesDir and saved there when missing
+bool KociembaSolution(const TCube &puzzle, std::vector<ETurnExt> &result, TSolveStats *stats = nullptr,
+                      const TReduceOptions *reduce = nullptr);      // No post-pass without reduce
+int KociembaEstimate(const TCube &puzzle);     // Lower bound of turns to reach G1, the costly part of the search;
+                                               // -1 if the G0 estimators reject the cubies, other unsolvable cubes get an estimate
 
 
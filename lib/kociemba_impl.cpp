@@ -1,105 +1,170 @@
 #include "kociemba_impl.h"
 #include "bfs2.h"
+#include "logger.h"
 #include <exception>
+#include <fstream>
+#include <stdexcept>
 
 
 // Base class for pruners
-class TBaseEstimator : private boost::noncopyable {
-    public:
-        using TCubeImageType = TCubeImage<2>;
-
-        const std::vector<TMove> &GetAllowedMoves() const;
-        TCubeImageType GetImage(const TCube &cube) const;
-        int Estimate(const TCube &cube) const;
-
-    protected:
-        void Init();
-        virtual size_t DoGetImage(const TCube &cube) const = 0;
-
-        TBaseEstimator(const std::vector<TMove> &allowedMoves);
-        ~TBaseEstimator();
-
-    private:
-        const std::vector<TMove> &AllowedMoves;
-        bool IsInit = false;
-        std::vector<int> Distances;
-
-        void SetDistance(size_t index, int value);
-};
-
-TBaseEstimator::TBaseEstimator(const std::vector<TMove> &allowedMoves)
-    : AllowedMoves(allowedMoves)
-{
+// Plain bfs over the images, the array of distances is the set of reached ones
+template <typename TDerived>
+void TBaseEstimator<TDerived>::Init(const std::vector<TMove> &allowedMoves) {
+    size_t imagesCount = static_cast<const TDerived &>(*this).GetImagesCount();
+    Distances.assign((imagesCount + 1) / 2, 0xFF);
+    std::vector<TCube> level(1, MakeSolvedCube()), nextLevel;
+    SetDistance(GetIndex(TCubeColors(level.front())), 0);
+    size_t reached = 1;
+    for (unsigned char distance = 1; !level.empty(); ++distance) {
+        for (const TCube &cube : level) {
+            for (const TMove &move : allowedMoves) {
+                TCube next = move.Act(cube);
+                size_t index = GetIndex(TCubeColors(next));
+                if (index >= imagesCount)
+                    throw std::logic_error("Image is out of the estimator table.");
+                if (GetDistance(index) != UNKNOWN_DISTANCE)
+                    continue;
+                if (distance >= UNKNOWN_DISTANCE)
+                    throw std::logic_error("Distance does not fit the estimator table.");
+                SetDistance(index, distance);
+                nextLevel.push_back(next);
+                ++reached;
+            }
+        }
+        level.swap(nextLevel);
+        nextLevel.clear();
+    }
+    LOGGER_INFO("Estimator table: " << reached << " positions");
 }
 
-TBaseEstimator::~TBaseEstimator() {
+template <typename TDerived>
+unsigned char TBaseEstimator<TDerived>::GetDistance(size_t index) const {
+    unsigned char pair = Distances[index / 2];
+    return (index % 2) ? (pair >> 4) : (pair & 0x0F);
 }
 
-const std::vector<TMove> &TBaseEstimator::GetAllowedMoves() const {
-    return AllowedMoves;
+template <typename TDerived>
+void TBaseEstimator<TDerived>::SetDistance(size_t index, unsigned char value) {
+    unsigned char &pair = Distances[index / 2];
+    if (index % 2)
+        pair = (pair & 0x0F) | (value << 4);
+    else
+        pair = (pair & 0xF0) | value;
 }
 
-void TBaseEstimator::Init() {
-    if (IsInit)
-        return;
-    IsInit = true;
-    std::unordered_map<TCubeImageType, TMove> reached;
-    PlainBFS(*this, reached, 21);
-    for (const auto &item : reached) {
-        int index = (static_cast<int>(item.first.Data[1]) << 8) + static_cast<int>(item.first.Data[0]);
-        SetDistance(index, item.second.GetTotalTurnsCount());
-    }
-    std::cout << reached.size() << std::endl;
+template <typename TDerived>
+typename TBaseEstimator<TDerived>::TCubeImageType TBaseEstimator<TDerived>::GetImage(const TCube &cube) const {
+    return GetImageByIndex(GetIndex(TCubeColors(cube)));
 }
 
-void TBaseEstimator::SetDistance(size_t index, int value) {
-    if (index >= Distances.size())
-        Distances.resize(index + 1, -1);
-    Distances[index] = value;
+template <typename TDerived>
+int TBaseEstimator<TDerived>::Estimate(const TCube &cube) const {
+    return EstimateByIndex(GetIndex(TCubeColors(cube)));
 }
 
-TBaseEstimator::TCubeImageType TBaseEstimator::GetImage(const TCube &cube) const {
-    int res = DoGetImage(cube);
+template <typename TDerived>
+typename TBaseEstimator<TDerived>::TCubeImageType TBaseEstimator<TDerived>::GetImageByIndex(size_t index) {
     TCubeImageType result;
-    result.Data[0] = (res & ((1 << 8) - 1));
-    result.Data[1] = ((res >> 8) & ((1 << 8) - 1));
+    result.Data[0] = (index & ((1 << 8) - 1));
+    result.Data[1] = ((index >> 8) & ((1 << 8) - 1));
     return result;
 }
 
-int TBaseEstimator::Estimate(const TCube &cube) const {
-    size_t idx = DoGetImage(cube);
-    return idx < Distances.size() ? Distances[idx] : -1;
+template <typename TDerived>
+int TBaseEstimator<TDerived>::EstimateByIndex(size_t index) const {
+    if (index / 2 >= Distances.size())
+        return -1;
+    unsigned char distance = GetDistance(index);
+    return distance != UNKNOWN_DISTANCE ? distance : -1;
 }
 
+template class TBaseEstimator<TG0CornersEstimator>;
+template class TBaseEstimator<TG0EdgeEstimator>;
+template class TBaseEstimator<TG0MiddleLayerEdgesEstimator>;
+template class TBaseEstimator<TG1CornersEstimator>;
+template class TBaseEstimator<TG1EdgeEstimator>;
+template class TBaseEstimator<TG1MiddleLayerEdgesEstimator>;
 
-// Pruning for corners in the stage 0
-class TG0CornersEstimator : public TBaseEstimator {
-    public:
-        static TG0CornersEstimator &Instance(const std::vector<TMove> &allowedMoves);
-
-    private:
-        TG0CornersEstimator(const std::vector<TMove> &allowedMoves);
-        ~TG0CornersEstimator();
 
-        size_t CalcCubieValue(const TCube &cube, const size_t *idxs) const;
-        size_t DoGetImage(const TCube &cube) const override;
-};
+static std::string TablesDir;                       // See SetTablesDir
 
-TG0CornersEstimator::TG0CornersEstimator(const std::vector<TMove> &allowedMoves)
-    : TBaseEstimator(allowedMoves)
-{
+void SetTablesDir(const std::string &dir) {
+    TablesDir = dir;
 }
 
-TG0CornersEstimator::~TG0CornersEstimator() {
+// Moves of some of the loaded positions are made again, so a table of another version is not used
+template<typename TStage>
+static bool CheckFrozenPositions(const TStage &stage, const typename TStage::TReachedPositions &positions) {
+    TCube solved = MakeSolvedCube();
+    for (size_t i = 0; i < positions.GetSize(); i += positions.GetSize() / 1024 + 1) {
+        if (!(stage.GetImage(positions.GetMove(i).Act(solved)) == positions.GetImage(i)))
+            return false;
+    }
+    return positions.GetSize() != 0;
+}
+
+// Identity of a table: the depth and the moves of its bfs and the hash its buckets are made of.
+// A table saved with another tag is made again, it would miss positions silently.
+template<typename TStage>
+static uint64_t GetFrozenPositionsTag(const TStage &stage, size_t depth) {
+    uint64_t tag = MixHash(depth);
+    for (const TMove &move : stage.GetAllowedMoves()) {
+        for (ETurnExt turn : Turns2Exts(move.GetTurns()))
+            tag = MixHash(tag ^ turn);
+        tag = MixHash(tag ^ 0xFF);
+    }
+    typename TStage::TCubeImageType probe;
+    for (size_t i = 0; i < sizeof(probe.Data); ++i)
+        probe.Data[i] = static_cast<unsigned char>(i * 37 + 1);
+    return MixHash(tag ^ GetImageHash(probe));
+}
+
+// Loads the table of a stage from the directory of tables, or makes it by bfs and saves it there
+template<typename TStage>
+static void FillFrozenPositions(TStage &stage, typename TStage::TReachedPositions &positions, TBloomFilter &filter,
+                                size_t depth, const std::string &name) {
+    std::string path = TablesDir.empty() ? std::string() : TablesDir + "/" + name + ".positions";
+    uint64_t tag = GetFrozenPositionsTag(stage, depth);
+    bool loaded = false;
+    if (!path.empty()) {
+        std::ifstream in(path, std::ios::binary);
+        loaded = in && positions.Load(in, tag) && CheckFrozenPositions(stage, positions);
+        if (loaded)
+            LOGGER_INFO("Loaded " << path);
+        else if (in)
+            LOGGER_WARNING("Can't use " << path << ", making the table again");
+    }
+    if (!loaded) {
+        std::unordered_map<typename TStage::TCubeImageType, TPackedTurns> reached;
+        PlainBFS(stage, reached, depth);
+        positions.Build(reached);
+        if (!path.empty()) {
+            std::ofstream out(path, std::ios::binary);
+            positions.Save(out, tag);
+            if (out)
+                LOGGER_INFO("Saved " << path);
+            else
+                LOGGER_WARNING("Can't save " << path);
+        }
+    }
+    filter.Reset(positions.GetSize());
+    for (size_t i = 0; i < positions.GetSize(); ++i)
+        filter.Add(GetImageHash(positions.GetImage(i)));
 }
 
-TG0CornersEstimator &TG0CornersEstimator::Instance(const std::vector<TMove> &allowedMoves) {
-    static TG0CornersEstimator Obj(allowedMoves);
-    Obj.Init();
-    return Obj;
+
+// Max of the estimates of a stage, -1 if any of them does not know the position
+static int CombineEstimates(int a, int b, int c, size_t *strongest) {
+    if (a == -1 || b == -1 || c == -1)
+        return -1;
+    if (strongest)
+        *strongest = (a >= b && a >= c) ? 0 : (b >= c ? 1 : 2);
+    return std::max(a, std::max(b, c));
 }
 
-size_t TG0CornersEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) const {
+
+// Pruning for corners in the stage 0
+size_t TG0CornersEstimator::CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const {
     size_t value = 0;
     for (size_t i = 0; i < 3; ++i) {
         EColor color = cube.GetColor(idxs[i]);
@@ -109,45 +174,22 @@ size_t TG0CornersEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs
     return value;
 }
 
-size_t TG0CornersEstimator::DoGetImage(const TCube &cube) const {
-    const std::vector<size_t> &corners = TCube::GetAllCorners();
+size_t TG0CornersEstimator::DoGetImage(const TCubeColors &cube) const {
     size_t res = 0;
-    for (size_t i = 0; i + 3 < corners.size(); i += 3) {        // Do not take the last cubie because of parity
+    for (size_t i = 0; i + 3 < TCube::NUM_CORNERS * 3; i += 3) {    // Do not take the last cubie because of parity
         res *= 3;
-        res += CalcCubieValue(cube, &corners[i]);
+        res += CalcCubieValue(cube, &TCube::CORNERS[i]);
     }
     return res;
 }
 
-
-// Pruning for edges in the stage 0
-class TG0EdgeEstimator : public TBaseEstimator {
-    public:
-        static TG0EdgeEstimator &Instance(const std::vector<TMove> &allowedMoves);
-
-    private:
-        TG0EdgeEstimator(const std::vector<TMove> &allowedMoves);
-        ~TG0EdgeEstimator();
-
-        size_t CalcCubieValue(const TCube &cube, const size_t *idxs) const;
-        size_t DoGetImage(const TCube &cube) const override;
-};
-
-TG0EdgeEstimator::TG0EdgeEstimator(const std::vector<TMove> &allowedMoves)
-    : TBaseEstimator(allowedMoves)
-{
-}
-
-TG0EdgeEstimator::~TG0EdgeEstimator() {
+size_t TG0CornersEstimator::GetImagesCount() const {
+    return 2187;                                // 3^7, the last corner is defined by the others
 }
 
-TG0EdgeEstimator &TG0EdgeEstimator::Instance(const std::vector<TMove> &allowedMoves) {
-    static TG0EdgeEstimator Obj(allowedMoves);
-    Obj.Init();
-    return Obj;
-}
 
-size_t TG0EdgeEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) const {
+// Pruning for edges in the stage 0
+size_t TG0EdgeEstimator::CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const {
     EColor c1 = cube.GetColor(idxs[0]), c2 = cube.GetColor(idxs[1]);
     if (c1 == C_RED || c1 == C_ORANGE)
         return 0;
@@ -160,62 +202,42 @@ size_t TG0EdgeEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) c
     throw std::logic_error("Bad cubie in edge estimator.");
 }
 
-size_t TG0EdgeEstimator::DoGetImage(const TCube &cube) const {
-    const std::vector<size_t> &edges = TCube::GetAllEdges();
+size_t TG0EdgeEstimator::DoGetImage(const TCubeColors &cube) const {
     size_t res = 0;
-    for (size_t i = 0; i + 2 < edges.size(); i += 2) {          // Do not take the last cubie because of parity
+    for (size_t i = 0; i + 2 < TCube::NUM_EDGES * 2; i += 2) {      // Do not take the last cubie because of parity
         res *= 2;
-        res += CalcCubieValue(cube, &edges[i]);
+        res += CalcCubieValue(cube, &TCube::EDGES[i]);
     }
     return res;
 }
 
-
-// Pruning for middle layer edges in the stage 0
-class TG0MiddleLayerEdgesEstimator : public TBaseEstimator {
-    public:
-        static TG0MiddleLayerEdgesEstimator &Instance(const std::vector<TMove> &allowedMoves);
-
-    private:
-        TG0MiddleLayerEdgesEstimator(const std::vector<TMove> &allowedMoves);
-        ~TG0MiddleLayerEdgesEstimator();
-
-        size_t CalcCubieValue(const TCube &cube, const size_t *idxs) const;
-        size_t DoGetImage(const TCube &cube) const override;
-};
-
-TG0MiddleLayerEdgesEstimator::TG0MiddleLayerEdgesEstimator(const std::vector<TMove> &allowedMoves)
-    : TBaseEstimator(allowedMoves)
-{
+size_t TG0EdgeEstimator::GetImagesCount() const {
+    return 2048;                                // 2^11, the last edge is defined by the others
 }
 
-TG0MiddleLayerEdgesEstimator::~TG0MiddleLayerEdgesEstimator() {
-}
 
-TG0MiddleLayerEdgesEstimator &TG0MiddleLayerEdgesEstimator::Instance(const std::vector<TMove> &allowedMoves) {
-    static TG0MiddleLayerEdgesEstimator Obj(allowedMoves);
-    Obj.Init();
-    return Obj;
-}
-
-size_t TG0MiddleLayerEdgesEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) const {
+// Pruning for middle layer edges in the stage 0
+size_t TG0MiddleLayerEdgesEstimator::CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const {
     EColor c1 = cube.GetColor(idxs[0]), c2 = cube.GetColor(idxs[1]);
     if (c1 == C_RED || c1 == C_ORANGE || c2 == C_RED || c2 == C_ORANGE)
         return 0;
     return 1;
 }
 
-size_t TG0MiddleLayerEdgesEstimator::DoGetImage(const TCube &cube) const {
-    const std::vector<size_t> &edges = TCube::GetAllEdges();
+size_t TG0MiddleLayerEdgesEstimator::DoGetImage(const TCubeColors &cube) const {
     size_t res = 0;
-    for (size_t i = 0; i + 2 < edges.size(); i += 2) {          // Do not take the last cubie because of parity
+    for (size_t i = 0; i + 2 < TCube::NUM_EDGES * 2; i += 2) {      // Do not take the last cubie because of parity
         res <<= 1;
-        if (CalcCubieValue(cube, &edges[i]))
+        if (CalcCubieValue(cube, &TCube::EDGES[i]))
             res |= 1;
     }
     return res;
 }
 
+size_t TG0MiddleLayerEdgesEstimator::GetImagesCount() const {
+    return 2048;                                // 2^11
+}
+
 
 // Main description of the stage 0
 TG0Stage::TG0Stage() {
@@ -231,11 +253,15 @@ TG0Stage &TG0Stage::Instance() {
 }
 
 TG0Stage::TCubeImageType TG0Stage::GetImage(const TCube &cube) const {
+    return GetImage(TCubeColors(cube));
+}
+
+TG0Stage::TCubeImageType TG0Stage::GetImage(const TCubeColors &cube) const {
     TCubeImageType result;
     for (size_t i = 0; i < 9; ++i)
         result.Data[i] = 0;
-    const auto &corners = TCube::GetAllCorners();
-    const auto &edges = TCube::GetAllEdges();
+    const size_t *corners = TCube::CORNERS;
+    const size_t *edges = TCube::EDGES;
     for (size_t i = 0; i < 24; ++i) {
         EColor color = cube.GetColor(corners[i]);
         if (color == C_RED || color == C_ORANGE)
@@ -256,26 +282,52 @@ const std::vector<TMove> &TG0Stage::GetAllowedMoves() const {
     return AllowedMoves;
 }
 
+const std::vector<unsigned int> &TG0Stage::GetCanonicalSuccessors() const {
+    return CanonicalSuccessors;
+}
+
 const TG0Stage::TReachedPositions &TG0Stage::GetReachedPositions() const {
     return ReachedPositions;
 }
 
-int TG0Stage::Estimate(const TCube &cube) const {
-    int a = TG0CornersEstimator::Instance(GetAllowedMoves()).Estimate(cube);
-    int b = TG0EdgeEstimator::Instance(GetAllowedMoves()).Estimate(cube);
-    int c = TG0MiddleLayerEdgesEstimator::Instance(GetAllowedMoves()).Estimate(cube);
-    if (a == -1 || b == -1 || c == -1)
-        return -1;
-    return std::max(a, std::max(b, c));
+int TG0Stage::Estimate(const TCube &cube, size_t *strongest) const {
+    TCubeColors colors(cube);
+    return CombineEstimates(CornersEstimator.EstimateByIndex(CornersEstimator.GetIndex(colors)),
+                            EdgeEstimator.EstimateByIndex(EdgeEstimator.GetIndex(colors)),
+                            MiddleLayerEdgesEstimator.EstimateByIndex(MiddleLayerEdgesEstimator.GetIndex(colors)),
+                            strongest);
+}
+
+TG0Stage::TEvaluation TG0Stage::Evaluate(const TCubeColors &colors) const {
+    TEvaluation result;
+    result.Image = GetImage(colors);
+    result.Strongest = 0;
+    result.Estimate = CombineEstimates(CornersEstimator.EstimateByIndex(CornersEstimator.GetIndex(colors)),
+                                       EdgeEstimator.EstimateByIndex(EdgeEstimator.GetIndex(colors)),
+                                       MiddleLayerEdgesEstimator.EstimateByIndex(MiddleLayerEdgesEstimator.GetIndex(colors)),
+                                       &result.Strongest);
+    return result;
+}
+
+const TG0CornersEstimator &TG0Stage::GetCornersEstimator() const {
+    return CornersEstimator;
+}
+
+const TG0EdgeEstimator &TG0Stage::GetEdgeEstimator() const {
+    return EdgeEstimator;
+}
+
+const TG0MiddleLayerEdgesEstimator &TG0Stage::GetMiddleLayerEdgesEstimator() const {
+    return MiddleLayerEdgesEstimator;
 }
 
 void TG0Stage::Init() {
     if (!AllowedMoves.empty())
         return;
     FillAllowedMoves();
-    TG0CornersEstimator::Instance(GetAllowedMoves());
-    TG0EdgeEstimator::Instance(GetAllowedMoves());
-    TG0MiddleLayerEdgesEstimator::Instance(GetAllowedMoves());
+    CornersEstimator.Init(AllowedMoves);
+    EdgeEstimator.Init(AllowedMoves);
+    MiddleLayerEdgesEstimator.Init(AllowedMoves);
     FillReachedPositions();
 }
 
@@ -284,58 +336,33 @@ void TG0Stage::FillAllowedMoves() {
                                           TE_L, TE_L1, TE_R, TE_R1, TE_F, TE_F1, TE_B, TE_B1 };
     for (auto move : moves)
         AllowedMoves.push_back(TurnExt2Move(move));
-    std::cout << AllowedMoves.size() << std::endl;
+    CanonicalSuccessors = MakeCanonicalSuccessors(AllowedMoves);
+    LOGGER_INFO("G0 stage: " << AllowedMoves.size() << " allowed moves");
 }
 
 void TG0Stage::FillReachedPositions() {
-    PlainBFS(*this, ReachedPositions, 6);
-    std::cout << ReachedPositions.size() << std::endl;
+    FillFrozenPositions(*this, ReachedPositions, ReachedFilter, 6, "g0");
+    LOGGER_INFO("G0 stage: " << ReachedPositions.GetSize() << " reached positions, " << ReachedPositions.GetBytes()
+                << " bytes in the table and " << ReachedFilter.GetBytes() << " bytes in its filter");
 }
 
 
-static size_t PermutationIndex(const std::vector<size_t> &p) {
-    size_t f = 1, n = p.size();
+static size_t PermutationIndex(const size_t *p, size_t n) {
+    size_t f = 1;
     for (size_t i = 0; i < n; ++i)
         f *= (i + 1);
-    auto begin = p.begin(), end = p.end();
     size_t res = 0;
     for (size_t i = 0; i < n; ++i) {
         f /= (n - i);
         size_t val = p[i];
-        res += (std::count_if(begin + i + 1, end, [val] (size_t item) { return item < val; }) * f);
+        res += (std::count_if(p + i + 1, p + n, [val] (size_t item) { return item < val; }) * f);
     }
     return res;
 }
 
 
 // Pruning for corners in the stage 1
-class TG1CornersEstimator : public TBaseEstimator {
-    public:
-        static TG1CornersEstimator &Instance(const std::vector<TMove> &allowedMoves);
-
-    private:
-        TG1CornersEstimator(const std::vector<TMove> &allowedMoves);
-        ~TG1CornersEstimator();
-
-        size_t CalcCubieValue(const TCube &cube, const size_t *idxs) const;
-        size_t DoGetImage(const TCube &cube) const override;
-};
-
-TG1CornersEstimator::TG1CornersEstimator(const std::vector<TMove> &allowedMoves)
-    : TBaseEstimator(allowedMoves)
-{
-}
-
-TG1CornersEstimator::~TG1CornersEstimator() {
-}
-
-TG1CornersEstimator &TG1CornersEstimator::Instance(const std::vector<TMove> &allowedMoves) {
-    static TG1CornersEstimator Obj(allowedMoves);
-    Obj.Init();
-    return Obj;
-}
-
-size_t TG1CornersEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) const {
+size_t TG1CornersEstimator::CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const {
     size_t value = 0;
     for (size_t i = 0; i < 3; ++i) {
         EColor color = cube.GetColor(idxs[i]);
@@ -349,43 +376,20 @@ size_t TG1CornersEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs
     return value;
 }
 
-size_t TG1CornersEstimator::DoGetImage(const TCube &cube) const {
-    const std::vector<size_t> &corners = TCube::GetAllCorners();
-    std::vector<size_t> p(corners.size() / 3);
-    for (size_t i = 0; i < corners.size(); i += 3)
-        p[i / 3] = CalcCubieValue(cube, &corners[i]);
-    return PermutationIndex(p);
+size_t TG1CornersEstimator::DoGetImage(const TCubeColors &cube) const {
+    size_t p[TCube::NUM_CORNERS];
+    for (size_t i = 0; i < TCube::NUM_CORNERS; ++i)
+        p[i] = CalcCubieValue(cube, &TCube::CORNERS[i * 3]);
+    return PermutationIndex(p, TCube::NUM_CORNERS);
 }
 
-
-// Pruning for edges in the stage 1
-class TG1EdgeEstimator : public TBaseEstimator {
-    public:
-        static TG1EdgeEstimator &Instance(const std::vector<TMove> &allowedMoves);
-
-    private:
-        TG1EdgeEstimator(const std::vector<TMove> &allowedMoves);
-        ~TG1EdgeEstimator();
-
-        size_t CalcCubieValue(const TCube &cube, const size_t *idxs) const;
-        size_t DoGetImage(const TCube &cube) const override;
-};
-
-TG1EdgeEstimator::TG1EdgeEstimator(const std::vector<TMove> &allowedMoves)
-    : TBaseEstimator(allowedMoves)
-{
+size_t TG1CornersEstimator::GetImagesCount() const {
+    return 40320;                               // 8!
 }
 
-TG1EdgeEstimator::~TG1EdgeEstimator() {
-}
 
-TG1EdgeEstimator &TG1EdgeEstimator::Instance(const std::vector<TMove> &allowedMoves) {
-    static TG1EdgeEstimator Obj(allowedMoves);
-    Obj.Init();
-    return Obj;
-}
-
-size_t TG1EdgeEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) const {
+// Pruning for edges in the stage 1
+size_t TG1EdgeEstimator::CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const {
     size_t value = 0;
     for (size_t i = 0; i < 2; ++i) {
         EColor color = cube.GetColor(idxs[i]);
@@ -401,43 +405,20 @@ size_t TG1EdgeEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) c
     return value;
 }
 
-size_t TG1EdgeEstimator::DoGetImage(const TCube &cube) const {
-    const std::vector<size_t> &edges = TCube::GetTopBottomEdges();
-    std::vector<size_t> p(edges.size() / 2);
-    for (size_t i = 0; i < edges.size(); i += 2)
-        p[i / 2] = CalcCubieValue(cube, &edges[i]);
-    return PermutationIndex(p);
+size_t TG1EdgeEstimator::DoGetImage(const TCubeColors &cube) const {
+    size_t p[TCube::NUM_TOP_BOTTOM_EDGES];
+    for (size_t i = 0; i < TCube::NUM_TOP_BOTTOM_EDGES; ++i)
+        p[i] = CalcCubieValue(cube, &TCube::EDGES[i * 2]);
+    return PermutationIndex(p, TCube::NUM_TOP_BOTTOM_EDGES);
 }
 
-
-// Pruning for middle layer edges in the stage 1
-class TG1MiddleLayerEdgesEstimator : public TBaseEstimator {
-    public:
-        static TG1MiddleLayerEdgesEstimator &Instance(const std::vector<TMove> &allowedMoves);
-
-    private:
-        TG1MiddleLayerEdgesEstimator(const std::vector<TMove> &allowedMoves);
-        ~TG1MiddleLayerEdgesEstimator();
-
-        size_t CalcCubieValue(const TCube &cube, const size_t *idxs) const;
-        size_t DoGetImage(const TCube &cube) const override;
-};
-
-TG1MiddleLayerEdgesEstimator::TG1MiddleLayerEdgesEstimator(const std::vector<TMove> &allowedMoves)
-    : TBaseEstimator(allowedMoves)
-{
-}
-
-TG1MiddleLayerEdgesEstimator::~TG1MiddleLayerEdgesEstimator() {
+size_t TG1EdgeEstimator::GetImagesCount() const {
+    return 40320;                               // 8!
 }
 
-TG1MiddleLayerEdgesEstimator &TG1MiddleLayerEdgesEstimator::Instance(const std::vector<TMove> &allowedMoves) {
-    static TG1MiddleLayerEdgesEstimator Obj(allowedMoves);
-    Obj.Init();
-    return Obj;
-}
 
-size_t TG1MiddleLayerEdgesEstimator::CalcCubieValue(const TCube &cube, const size_t *idxs) const {
+// Pruning for middle layer edges in the stage 1
+size_t TG1MiddleLayerEdgesEstimator::CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const {
     size_t value = 0;
     for (size_t i = 0; i < 2; ++i) {
         EColor color = cube.GetColor(idxs[i]);
@@ -449,12 +430,15 @@ size_t TG1MiddleLayerEdgesEstimator::CalcCubieValue(const TCube &cube, const siz
     return value;
 }
 
-size_t TG1MiddleLayerEdgesEstimator::DoGetImage(const TCube &cube) const {
-    const std::vector<size_t> &edges = TCube::GetMiddleEdges();
-    std::vector<size_t> p(edges.size() / 2);
-    for (size_t i = 0; i < edges.size(); i += 2)
-        p[i / 2] = CalcCubieValue(cube, &edges[i]);
-    return PermutationIndex(p);
+size_t TG1MiddleLayerEdgesEstimator::DoGetImage(const TCubeColors &cube) const {
+    size_t p[TCube::NUM_EDGES - TCube::NUM_TOP_BOTTOM_EDGES];
+    for (size_t i = TCube::NUM_TOP_BOTTOM_EDGES; i < TCube::NUM_EDGES; ++i)
+        p[i - TCube::NUM_TOP_BOTTOM_EDGES] = CalcCubieValue(cube, &TCube::EDGES[i * 2]);
+    return PermutationIndex(p, TCube::NUM_EDGES - TCube::NUM_TOP_BOTTOM_EDGES);
+}
+
+size_t TG1MiddleLayerEdgesEstimator::GetImagesCount() const {
+    return 24;                                  // 4!
 }
 
 
@@ -471,11 +455,12 @@ TG1Stage &TG1Stage::Instance() {
     return Obj;
 }
 
-TG1Stage::TCubeImageType TG1Stage::GetImage(const TCube &cube) const {
-    TCubeImageType result;
-    const auto &cornersImage = TG1CornersEstimator::Instance(GetAllowedMoves()).GetImage(cube);
-    const auto &edgesImage = TG1EdgeEstimator::Instance(GetAllowedMoves()).GetImage(cube);
-    const auto &middleImage = TG1MiddleLayerEdgesEstimator::Instance(GetAllowedMoves()).GetImage(cube);
+// The image is made of the coordinates of the estimators
+static TG1Stage::TCubeImageType MakeG1Image(size_t corners, size_t edges, size_t middle) {
+    TG1Stage::TCubeImageType result;
+    const auto &cornersImage = TG1CornersEstimator::GetImageByIndex(corners);
+    const auto &edgesImage = TG1EdgeEstimator::GetImageByIndex(edges);
+    const auto &middleImage = TG1MiddleLayerEdgesEstimator::GetImageByIndex(middle);
     result.Data[0] = cornersImage.Data[0];
     result.Data[1] = cornersImage.Data[1];
     result.Data[2] = edgesImage.Data[0];
@@ -484,30 +469,65 @@ TG1Stage::TCubeImageType TG1Stage::GetImage(const TCube &cube) const {
     return result;
 }
 
+TG1Stage::TCubeImageType TG1Stage::GetImage(const TCube &cube) const {
+    return GetImage(TCubeColors(cube));
+}
+
+TG1Stage::TCubeImageType TG1Stage::GetImage(const TCubeColors &colors) const {
+    return MakeG1Image(CornersEstimator.GetIndex(colors), EdgeEstimator.GetIndex(colors), MiddleLayerEdgesEstimator.GetIndex(colors));
+}
+
 const std::vector<TMove> &TG1Stage::GetAllowedMoves() const {
     return AllowedMoves;
 }
 
+const std::vector<unsigned int> &TG1Stage::GetCanonicalSuccessors() const {
+    return CanonicalSuccessors;
+}
+
 const TG1Stage::TReachedPositions &TG1Stage::GetReachedPositions() const {
     return ReachedPositions;
 }
 
-int TG1Stage::Estimate(const TCube &cube) const {
-    int a = TG1CornersEstimator::Instance(GetAllowedMoves()).Estimate(cube);
-    int b = TG1EdgeEstimator::Instance(GetAllowedMoves()).Estimate(cube);
-    int c = TG1MiddleLayerEdgesEstimator::Instance(GetAllowedMoves()).Estimate(cube);
-    if (a == -1 || b == -1 || c == -1)
-        return -1;
-    return std::max(a, std::max(b, c));
+int TG1Stage::Estimate(const TCube &cube, size_t *strongest) const {
+    TEvaluation evaluation = Evaluate(TCubeColors(cube));
+    if (strongest && evaluation.Estimate != -1)
+        *strongest = evaluation.Strongest;
+    return evaluation.Estimate;
+}
+
+// Every coordinate is computed once for both the image and the estimate
+TG1Stage::TEvaluation TG1Stage::Evaluate(const TCubeColors &colors) const {
+    size_t corners = CornersEstimator.GetIndex(colors);
+    size_t edges = EdgeEstimator.GetIndex(colors);
+    size_t middle = MiddleLayerEdgesEstimator.GetIndex(colors);
+    TEvaluation result;
+    result.Image = MakeG1Image(corners, edges, middle);
+    result.Strongest = 0;
+    result.Estimate = CombineEstimates(CornersEstimator.EstimateByIndex(corners), EdgeEstimator.EstimateByIndex(edges),
+                                       MiddleLayerEdgesEstimator.EstimateByIndex(middle), &result.Strongest);
+    return result;
+}
+
+const TG1CornersEstimator &TG1Stage::GetCornersEstimator() const {
+    return CornersEstimator;
+}
+
+const TG1EdgeEstimator &TG1Stage::GetEdgeEstimator() const {
+    return EdgeEstimator;
+}
+
+const TG1MiddleLayerEdgesEstimator &TG1Stage::GetMiddleLayerEdgesEstimator() const {
+    return MiddleLayerEdgesEstimator;
 }
 
 void TG1Stage::Init() {
     if (!AllowedMoves.empty())
         return;
     FillAllowedMoves();
-    TG1CornersEstimator::Instance(GetAllowedMoves());
-    TG1EdgeEstimator::Instance(GetAllowedMoves());
-    TG1MiddleLayerEdgesEstimator::Instance(GetAllowedMoves());
+    CornersEstimator.Init(AllowedMoves);
+    EdgeEstimator.Init(AllowedMoves);
+    MiddleLayerEdgesEstimator.Init(AllowedMoves);
     FillReachedPositions();
 }
 
@@ -515,11 +535,13 @@ void TG1Stage::FillAllowedMoves() {
     static constexpr ETurnExt moves[] = { TE_U, TE_U2, TE_U1, TE_D, TE_D2, TE_D1, TE_L2, TE_R2, TE_F2, TE_B2 };
     for (auto move : moves)
         AllowedMoves.push_back(TurnExt2Move(move));
-    std::cout << AllowedMoves.size() << std::endl;
+    CanonicalSuccessors = MakeCanonicalSuccessors(AllowedMoves);
+    LOGGER_INFO("G1 stage: " << AllowedMoves.size() << " allowed moves");
 }
 
 void TG1Stage::FillReachedPositions() {
-    PlainBFS(*this, ReachedPositions, 8);
-    std::cout << ReachedPositions.size() << std::endl;
+    FillFrozenPositions(*this, ReachedPositions, ReachedFilter, 8, "g1");
+    LOGGER_INFO("G1 stage: " << ReachedPositions.GetSize() << " reached positions, " << ReachedPositions.GetBytes()
+                << " bytes in the table and " << ReachedFilter.GetBytes() << " bytes in its filter");
 }
 
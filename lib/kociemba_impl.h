@@ -1,26 +1,150 @@
 #pragma once
 
+#include "bloom_filter.h"
 #include "cube.h"
+#include "frozen_positions.h"
 #include <boost/noncopyable.hpp>
-#include <unordered_map>
+#include <string>
 
 
+/*
+    Base class for pruners, TDerived provides DoGetImage and GetImagesCount.
+    Calls are dispatched statically, so the coordinates are computed inline by the stages owning the pruners.
+*/
+template <typename TDerived>
+class TBaseEstimator : private boost::noncopyable {
+    public:
+        using TCubeImageType = TCubeImage<2>;
+
+        void Init(const std::vector<TMove> &allowedMoves);
+        TCubeImageType GetImage(const TCube &cube) const;
+        int Estimate(const TCube &cube) const;
+
+        // The same for the decoded cube, split so a stage can reuse the coordinate for its image and estimate
+        size_t GetIndex(const TCubeColors &colors) const {
+            return static_cast<const TDerived &>(*this).DoGetImage(colors);
+        }
+        static TCubeImageType GetImageByIndex(size_t index);
+        int EstimateByIndex(size_t index) const;            // -1 for unknown coordinates
+
+    protected:
+        TBaseEstimator() = default;
+        ~TBaseEstimator() = default;
+
+    private:
+        static constexpr unsigned char UNKNOWN_DISTANCE = 15;
+
+        std::vector<unsigned char> Distances;               // Two 4-bit distances per byte, indexed by DoGetImage
+
+        unsigned char GetDistance(size_t index) const;
+        void SetDistance(size_t index, unsigned char value);
+};
+
+
+// Pruning for corners in the stage 0
+class TG0CornersEstimator : public TBaseEstimator<TG0CornersEstimator> {
+    private:
+        friend class TBaseEstimator<TG0CornersEstimator>;
+
+        size_t CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const;
+        size_t DoGetImage(const TCubeColors &cube) const;
+        size_t GetImagesCount() const;                      // DoGetImage is below this
+};
+
+
+// Pruning for edges in the stage 0
+class TG0EdgeEstimator : public TBaseEstimator<TG0EdgeEstimator> {
+    private:
+        friend class TBaseEstimator<TG0EdgeEstimator>;
+
+        size_t CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const;
+        size_t DoGetImage(const TCubeColors &cube) const;
+        size_t GetImagesCount() const;                      // DoGetImage is below this
+};
+
+
+// Pruning for middle layer edges in the stage 0
+class TG0MiddleLayerEdgesEstimator : public TBaseEstimator<TG0MiddleLayerEdgesEstimator> {
+    private:
+        friend class TBaseEstimator<TG0MiddleLayerEdgesEstimator>;
+
+        size_t CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const;
+        size_t DoGetImage(const TCubeColors &cube) const;
+        size_t GetImagesCount() const;                      // DoGetImage is below this
+};
+
+
+// Pruning for corners in the stage 1
+class TG1CornersEstimator : public TBaseEstimator<TG1CornersEstimator> {
+    private:
+        friend class TBaseEstimator<TG1CornersEstimator>;
+
+        size_t CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const;
+        size_t DoGetImage(const TCubeColors &cube) const;
+        size_t GetImagesCount() const;                      // DoGetImage is below this
+};
+
+
+// Pruning for edges in the stage 1
+class TG1EdgeEstimator : public TBaseEstimator<TG1EdgeEstimator> {
+    private:
+        friend class TBaseEstimator<TG1EdgeEstimator>;
+
+        size_t CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const;
+        size_t DoGetImage(const TCubeColors &cube) const;
+        size_t GetImagesCount() const;                      // DoGetImage is below this
+};
+
+
+// Pruning for middle layer edges in the stage 1
+class TG1MiddleLayerEdgesEstimator : public TBaseEstimator<TG1MiddleLayerEdgesEstimator> {
+    private:
+        friend class TBaseEstimator<TG1MiddleLayerEdgesEstimator>;
+
+        size_t CalcCubieValue(const TCubeColors &cube, const size_t *idxs) const;
+        size_t DoGetImage(const TCubeColors &cube) const;
+        size_t GetImagesCount() const;                      // DoGetImage is below this
+};
+
+
+// Main description of the stage 0
 class TG0Stage : private boost::noncopyable {
     public:
         using TCubeImageType = TCubeImage<9>;
-        using TReachedPositions = std::unordered_map<TCubeImageType, TMove>;
+        using TReachedPositions = TFrozenPositions<9>;
+
+        // Everything the search needs to know about a node
+        struct TEvaluation {
+            TCubeImageType Image;
+            int Estimate;                                   // -1 for impossible positions
+            size_t Strongest;                               // Estimator giving the bound
+        };
 
         static TG0Stage &Instance();
 
         TCubeImageType GetImage(const TCube &cube) const;
+        TCubeImageType GetImage(const TCubeColors &colors) const;
         const std::vector<TMove> &GetAllowedMoves() const;
+        const std::vector<unsigned int> &GetCanonicalSuccessors() const;       // See MakeCanonicalSuccessors
         const TReachedPositions &GetReachedPositions() const;
+        bool MayBeReached(const TCubeImageType &image) const {         // False is exact, true needs the lookup
+            return ReachedFilter.MayContain(GetImageHash(image));
+        }
 
-        int Estimate(const TCube &cube) const;
+        int Estimate(const TCube &cube, size_t *strongest = nullptr) const;     // Optionally tells which estimator gave the bound
+        TEvaluation Evaluate(const TCubeColors &colors) const;                  // Image and estimate at once
+        const TG0CornersEstimator &GetCornersEstimator() const;
+        const TG0EdgeEstimator &GetEdgeEstimator() const;
+        const TG0MiddleLayerEdgesEstimator &GetMiddleLayerEdgesEstimator() const;
 
     private:
         std::vector<TMove> AllowedMoves;
+        std::vector<unsigned int> CanonicalSuccessors;
         TReachedPositions ReachedPositions;
+        TBloomFilter ReachedFilter;
+        TG0CornersEstimator CornersEstimator;
+        TG0EdgeEstimator EdgeEstimator;
+        TG0MiddleLayerEdgesEstimator MiddleLayerEdgesEstimator;
 
         TG0Stage();
         ~TG0Stage();
@@ -31,22 +155,44 @@ class TG0Stage : private boost::noncopyable {
 };
 
 
+// Main description of the stage 1
 class TG1Stage : private boost::noncopyable {
     public:
         using TCubeImageType = TCubeImage<5>;
-        using TReachedPositions = std::unordered_map<TCubeImageType, TMove>;
+        using TReachedPositions = TFrozenPositions<5>;
+
+        // Everything the search needs to know about a node
+        struct TEvaluation {
+            TCubeImageType Image;
+            int Estimate;                                   // -1 for impossible positions
+            size_t Strongest;                               // Estimator giving the bound
+        };
 
         static TG1Stage &Instance();
 
         TCubeImageType GetImage(const TCube &cube) const;
+        TCubeImageType GetImage(const TCubeColors &colors) const;
         const std::vector<TMove> &GetAllowedMoves() const;
+        const std::vector<unsigned int> &GetCanonicalSuccessors() const;       // See MakeCanonicalSuccessors
         const TReachedPositions &GetReachedPositions() const;
+        bool MayBeReached(const TCubeImageType &image) const {         // False is exact, true needs the lookup
+            return ReachedFilter.MayContain(GetImageHash(image));
+        }
 
-        int Estimate(const TCube &cube) const;
+        int Estimate(const TCube &cube, size_t *strongest = nullptr) const;     // Optionally tells which estimator gave the bound
+        TEvaluation Evaluate(const TCubeColors &colors) const;                  // Image and estimate at once
+        const TG1CornersEstimator &GetCornersEstimator() const;
+        const TG1EdgeEstimator &GetEdgeEstimator() const;
+        const TG1MiddleLayerEdgesEstimator &GetMiddleLayerEdgesEstimator() const;
 
     private:
         std::vector<TMove> AllowedMoves;
+        std::vector<unsigned int> CanonicalSuccessors;
         TReachedPositions ReachedPositions;
+        TBloomFilter ReachedFilter;
+        TG1CornersEstimator CornersEstimator;
+        TG1EdgeEstimator EdgeEstimator;
+        TG1MiddleLayerEdgesEstimator MiddleLayerEdgesEstimator;
 
         TG1Stage();
         ~TG1Stage();
@@ -57,3 +203,6 @@ class TG1Stage : private boost::noncopyable {
 };
 
 
+// Directory where the stages keep their tables of reached positions, empty to make them on every start.
+// Must be set before the stages are built.
+void SetTablesDir(const std::string &dir);
@@ -0,0 +1,99 @@
+#include "logger.h"
+
+
+//
+// TLogger
+//
+
+TLogger::TLogger()
+    : WritingThread([this]() { WritingThreadMethod(); })
+{
+}
+
+TLogger::~TLogger() {
+    {
+        std::unique_lock<std::mutex> lk(Mutex);
+        Exit = true;
+    }
+    Condition.notify_one();
+    WritingThread.join();
+}
+
+TLogger &TLogger::Instance() {
+    static TLogger logger;
+    return logger;
+}
+
+void TLogger::SetLevel(ELogLevel level) {
+    Level.store(level, std::memory_order_relaxed);
+}
+
+void TLogger::SetConsole(FILE *console) {
+    Console.store(console, std::memory_order_relaxed);
+}
+
+bool TLogger::IsEnabled(ELogLevel level) const {
+    return level >= Level.load(std::memory_order_relaxed);
+}
+
+void TLogger::Write(ELogLevel level, std::string message) {
+    static const char *prefixes[] = { "[debug] ", "[info] ", "[warning] ", "[error] " };
+    message.insert(0, prefixes[level]);
+    message += '\n';
+    bool wasEmpty = false;
+    {
+        std::unique_lock<std::mutex> lk(Mutex);
+        if (Buffer.size() >= MAX_BUFFERED) {
+            ++Dropped;
+            return;
+        }
+        wasEmpty = Buffer.empty();
+        Buffer.push_back(std::move(message));
+        ++Enqueued;
+    }
+    if (wasEmpty)
+        Condition.notify_one();
+}
+
+void TLogger::Flush() {
+    std::unique_lock<std::mutex> lk(Mutex);
+    size_t target = Enqueued;
+    FlushedCondition.wait(lk, [this, target]() { return Written >= target || Exit; });
+}
+
+size_t TLogger::GetDroppedCount() const {
+    std::unique_lock<std::mutex> lk(Mutex);
+    return Dropped;
+}
+
+void TLogger::WritingThreadMethod() {
+    std::vector<std::string> batch;
+    std::unique_lock<std::mutex> lk(Mutex);
+    for (; ;) {
+        Condition.wait(lk, [this]() { return Exit || !Buffer.empty(); });
+        if (Buffer.empty() && Exit)
+            return;
+        batch.swap(Buffer);
+        lk.unlock();
+        FILE *console = Console.load(std::memory_order_relaxed);
+        for (const std::string &message : batch)
+            fwrite(message.data(), 1, message.size(), console);
+        fflush(console);
+        size_t count = batch.size();
+        batch.clear();
+        lk.lock();
+        Written += count;
+        FlushedCondition.notify_all();
+    }
+}
+
+
+ELogLevel ParseLogLevel(const std::string &level) {
+    if (level == "debug")
+        return LL_DEBUG;
+    if (level == "warning")
+        return LL_WARNING;
+    if (level == "error")
+        return LL_ERROR;
+    return LL_INFO;
+}
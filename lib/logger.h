@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+
+enum ELogLevel {
+    LL_DEBUG,
+    LL_INFO,
+    LL_WARNING,
+    LL_ERROR
+};
+
+
+/*
+    Diagnostic log of the library and the server.
+    Callers only format the message and append it to the buffer, the console is written and flushed
+    by the logging thread, so printing never stalls the solver or the network threads.
+    Debug messages are compiled only with RUBIKS_DEBUG_LOG, other levels are filtered at runtime.
+*/
+class TLogger : private boost::noncopyable {
+    public:
+        static TLogger &Instance();
+
+        void SetLevel(ELogLevel level);
+        void SetConsole(FILE *console);                     // stdout by default, tools writing their output there take stderr
+        bool IsEnabled(ELogLevel level) const;
+        void Write(ELogLevel level, std::string message);  // Dropped when too many messages wait for the thread
+        void Flush();                                       // Waits until everything written before is on the console
+        size_t GetDroppedCount() const;
+
+    private:
+        static constexpr size_t MAX_BUFFERED = 65536;
+
+        std::atomic<int> Level{LL_INFO};
+        std::atomic<FILE *> Console{stdout};
+        mutable std::mutex Mutex;
+        std::condition_variable Condition;                  // Signals new messages to the thread
+        std::condition_variable FlushedCondition;           // Signals written batches to Flush
+        std::vector<std::string> Buffer;
+        size_t Enqueued = 0;                                // Messages put to the buffer so far
+        size_t Written = 0;                                 // Messages written by the thread so far
+        size_t Dropped = 0;
+        bool Exit = false;
+        std::thread WritingThread;
+
+        TLogger();
+        ~TLogger();
+
+        void WritingThreadMethod();
+};
+
+ELogLevel ParseLogLevel(const std::string &level);         // "debug", "info", "warning" or "error"
+
+
+#define LOGGER_WRITE(level, message) \
+    do { \
+        if (TLogger::Instance().IsEnabled(level)) { \
+            std::ostringstream loggerStream; \
+            loggerStream << message; \
+            TLogger::Instance().Write(level, loggerStream.str()); \
+        } \
+    } while (false)
+
+#ifdef RUBIKS_DEBUG_LOG
+#define LOGGER_DEBUG(message) LOGGER_WRITE(LL_DEBUG, message)
+#else
+#define LOGGER_DEBUG(message) do {} while (false)
+#endif
+#define LOGGER_INFO(message) LOGGER_WRITE(LL_INFO, message)
+#define LOGGER_WARNING(message) LOGGER_WRITE(LL_WARNING, message)
+#define LOGGER_ERROR(message) LOGGER_WRITE(LL_ERROR, message)
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+
+/*
+    Counters of one search stage, filled by BFS2 on the stack and copied out at the end,
+    so collecting them costs a few increments per node.
+*/
+struct TStageStats {
+    static constexpr size_t MAX_ESTIMATORS = 3;
+
+    size_t NodesExpanded = 0;                       // Positions taken from the queue and turned
+    size_t NodesGenerated = 0;                      // Positions produced from done moves and by turns
+    size_t HashLookups = 0;                         // Lookups in the reached, backward and result tables
+    size_t BackwardHits = 0;                        // Positions found in the table of the stage
+    size_t BackwardFiltered = 0;                    // Lookups in the table of the stage skipped by its filter
+    size_t PrunedByDepth = 0;                       // Positions cut by the limit on turns in the stage
+    size_t PrunedByEstimator[MAX_ESTIMATORS] = {};  // Positions cut by the estimate, by the estimator giving the bound
+    size_t Candidates = 0;                          // Solutions of the stage returned
+    size_t PeakReachedSize = 0;                     // Size of the table of reached positions
+    double Seconds = 0;
+};
+
+
+// Counters of the whole solve
+struct TSolveStats {
+    static constexpr size_t STAGES_COUNT = 2;
+
+    TStageStats Stages[STAGES_COUNT];
+    size_t TurnsSaved = 0;                          // By the post-pass over the solution
+    double ReduceSeconds = 0;                       // Spent in the post-pass
+    double Seconds = 0;
+};